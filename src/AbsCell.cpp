@@ -67,6 +67,14 @@ void AbsCell::Destroy()
   m_next = NULL;
 }
 
+size_t AbsCell::GetMemorySize()
+{
+  return sizeof(AbsCell) +
+    GetListMemorySize(m_innerCell) +
+    GetListMemorySize(m_open) +
+    GetListMemorySize(m_close);
+}
+
 void AbsCell::SetInner(MathCell *inner)
 {
   if (inner == NULL)
@@ -38,6 +38,7 @@ public:
   AbsCell();
   ~AbsCell();
   void Destroy();
+  size_t GetMemorySize();
   void SetInner(MathCell *inner);
   MathCell* Copy();
   void SelectInner(wxRect& rect, MathCell** first, MathCell** last);
@@ -67,6 +67,13 @@ void AtCell::Destroy()
   m_next = NULL;
 }
 
+size_t AtCell::GetMemorySize()
+{
+  return sizeof(AtCell) +
+    GetListMemorySize(m_baseCell) +
+    GetListMemorySize(m_indexCell);
+}
+
 
 void AtCell::SetIndex(MathCell *index)
 {
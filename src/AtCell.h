@@ -31,6 +31,7 @@ public:
   ~AtCell();
   MathCell* Copy();
   void Destroy();
+  size_t GetMemorySize();
   void SetBase(MathCell *base);
   void SetIndex(MathCell *index);
   void RecalculateSize(CellParser& parser, int fontsize);
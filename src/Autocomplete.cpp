@@ -23,15 +23,25 @@
 #include "Dirstructure.h"
 
 #include <wx/textfile.h>
+#include <algorithm>
+#include <vector>
 
 AutoComplete::AutoComplete()
 {
   m_args.Compile(wxT("[[]<([^>]*)>[]]"));
+  for(int i=command;i<=unit;i++)
+    m_fuzzyIndexValid[i] = false;
 }
 
 bool AutoComplete::LoadSymbols(wxString file)
 {
-  if (!wxFileExists(file))
+  // The build system generates an index from the symbol list that already is
+  // sorted and whose templates already have been fixed.
+  wxString indexFile = file.BeforeLast(wxT('.')) + wxT(".idx");
+  bool presorted = wxFileExists(indexFile);
+  if (presorted)
+    file = indexFile;
+  else if (!wxFileExists(file))
     return false;
 
   for(int i=command;i<=unit;i++)
@@ -40,61 +50,73 @@ bool AutoComplete::LoadSymbols(wxString file)
       m_wordList[i].Clear();
   }
  
-  wxString line;
-  wxString rest, function;
   wxTextFile index(file);
 
   index.Open();
 
-  for(line = index.GetFirstLine(); !index.Eof(); line = index.GetNextLine())
+  for(size_t i = 0; i < index.GetLineCount(); i++)
   {
+    const wxString &line = index[i];
     if (line.StartsWith(wxT("FUNCTION: ")) ||
         line.StartsWith(wxT("OPTION  : ")))
       m_wordList[command].Add(line.Mid(10));
     else if (line.StartsWith(wxT("TEMPLATE: ")))
-      m_wordList[tmplte].Add(FixTemplate(line.Mid(10)));
-      else if
-        (line.StartsWith(wxT("UNIT: ")))
+    {
+      if (presorted)
+        m_wordList[tmplte].Add(line.Mid(10));
+      else
+        m_wordList[tmplte].Add(FixTemplate(line.Mid(10)));
+    }
+    else if (line.StartsWith(wxT("UNIT: ")))
+    {
+      if (presorted)
+        m_wordList[unit].Add(line.Mid(6));
+      else
         m_wordList[unit].Add(FixTemplate(line.Mid(6)));
+    }
   }
 
   index.Close();
 
+  // The symbols that aren't part of the symbol list. They are sorted
+  // separately and then merged into the word lists.
+  wxArrayString extra[3];
+
   /// Add wxMaxima functions
-  m_wordList[command].Add(wxT("wxanimate_framerate"));
-  m_wordList[command].Add(wxT("wxplot_pngcairo"));
-  m_wordList[command].Add(wxT("set_display"));
-  m_wordList[command].Add(wxT("wxplot2d"));
-  m_wordList[tmplte].Add(wxT("wxplot2d(<expr>,<x_range>)"));
-  m_wordList[command].Add(wxT("wxplot3d"));
-  m_wordList[tmplte].Add(wxT("wxplot3d(<expr>,<x_range>,<y_range>)"));
-  m_wordList[command].Add(wxT("wximplicit_plot"));
-  m_wordList[command].Add(wxT("wxcontour_plot"));
-  m_wordList[command].Add(wxT("wxanimate"));
-  m_wordList[command].Add(wxT("wxanimate_draw"));
-  m_wordList[command].Add(wxT("wxanimate_draw3d"));
-  m_wordList[command].Add(wxT("with_slider"));
-  m_wordList[tmplte].Add(wxT("with_slider(<a_var>,<a_list>,<expr>,<x_range>)"));
-  m_wordList[command].Add(wxT("with_slider_draw"));
-  m_wordList[command].Add(wxT("with_slider_draw3d"));
-  m_wordList[command].Add(wxT("wxdraw"));
-  m_wordList[command].Add(wxT("wxdraw2d"));
-  m_wordList[command].Add(wxT("wxdraw3d"));
-  m_wordList[command].Add(wxT("wxfilename"));
-  m_wordList[command].Add(wxT("wxhistogram"));
-  m_wordList[command].Add(wxT("wxscatterplot"));
-  m_wordList[command].Add(wxT("wxbarsplot"));
-  m_wordList[command].Add(wxT("wxpiechart"));
-  m_wordList[command].Add(wxT("wxboxplot"));
-  m_wordList[command].Add(wxT("wxplot_size"));
-  m_wordList[command].Add(wxT("wxdraw_list"));
-  m_wordList[command].Add(wxT("table_form"));
-  m_wordList[command].Add(wxT("wxbuild_info"));
-  m_wordList[tmplte].Add(wxT("table_form(<data>)"));
-  m_wordList[tmplte].Add(wxT("table_form(<data>,<[options]>)"));
-  m_wordList[command].Add(wxT("wxsubscripts"));
-  m_wordList[command].Add(wxT("wxdeclare_subscripted"));
-  m_wordList[tmplte].Add(wxT("wxdeclare_subscripted(<name>,<[false]>)"));
+  extra[command].Add(wxT("wxanimate_framerate"));
+  extra[command].Add(wxT("wxplot_pngcairo"));
+  extra[command].Add(wxT("set_display"));
+  extra[command].Add(wxT("wxplot2d"));
+  extra[tmplte].Add(wxT("wxplot2d(<expr>,<x_range>)"));
+  extra[command].Add(wxT("wxplot3d"));
+  extra[tmplte].Add(wxT("wxplot3d(<expr>,<x_range>,<y_range>)"));
+  extra[command].Add(wxT("wximplicit_plot"));
+  extra[command].Add(wxT("wxcontour_plot"));
+  extra[command].Add(wxT("wxanimate"));
+  extra[command].Add(wxT("wxanimate_draw"));
+  extra[command].Add(wxT("wxanimate_draw3d"));
+  extra[command].Add(wxT("with_slider"));
+  extra[tmplte].Add(wxT("with_slider(<a_var>,<a_list>,<expr>,<x_range>)"));
+  extra[command].Add(wxT("with_slider_draw"));
+  extra[command].Add(wxT("with_slider_draw3d"));
+  extra[command].Add(wxT("wxdraw"));
+  extra[command].Add(wxT("wxdraw2d"));
+  extra[command].Add(wxT("wxdraw3d"));
+  extra[command].Add(wxT("wxfilename"));
+  extra[command].Add(wxT("wxhistogram"));
+  extra[command].Add(wxT("wxscatterplot"));
+  extra[command].Add(wxT("wxbarsplot"));
+  extra[command].Add(wxT("wxpiechart"));
+  extra[command].Add(wxT("wxboxplot"));
+  extra[command].Add(wxT("wxplot_size"));
+  extra[command].Add(wxT("wxdraw_list"));
+  extra[command].Add(wxT("table_form"));
+  extra[command].Add(wxT("wxbuild_info"));
+  extra[tmplte].Add(wxT("table_form(<data>)"));
+  extra[tmplte].Add(wxT("table_form(<data>,<[options]>)"));
+  extra[command].Add(wxT("wxsubscripts"));
+  extra[command].Add(wxT("wxdeclare_subscripted"));
+  extra[tmplte].Add(wxT("wxdeclare_subscripted(<name>,<[false]>)"));
 
   /// Load private symbol list (do something different on Windows).
   wxString privateList;
@@ -108,25 +130,91 @@ bool AutoComplete::LoadSymbols(wxString file)
 
     priv.Open();
 
-    for(line = priv.GetFirstLine(); !priv.Eof(); line = priv.GetNextLine())
+    for(size_t i = 0; i < priv.GetLineCount(); i++)
     {
+      const wxString &line = priv[i];
       if (line.StartsWith(wxT("FUNCTION: ")) ||
           line.StartsWith(wxT("OPTION  : ")))
-        m_wordList[command].Add(line.Mid(10));
+        extra[command].Add(line.Mid(10));
       else if (line.StartsWith(wxT("TEMPLATE: ")))
-        m_wordList[tmplte].Add(FixTemplate(line.Mid(10)));
+        extra[tmplte].Add(FixTemplate(line.Mid(10)));
       else if (line.StartsWith(wxT("UNIT: ")))
-        m_wordList[unit].Add(FixTemplate(line.Mid(6)));      
+        extra[unit].Add(FixTemplate(line.Mid(6)));      
     }
 
     priv.Close();
   }
 
-  m_wordList[command].Sort();
-  m_wordList[tmplte].Sort();
-  m_wordList[unit].Sort();
+  for(int i=command;i<=unit;i++)
+  {
+    if (!presorted)
+      SortAndRemoveDuplicates(m_wordList[i]);
+    SortAndRemoveDuplicates(extra[i]);
+    MergeSorted(m_wordList[i], extra[i]);
+    m_fuzzyIndexValid[i] = false;
+  }
 
-  return false;
+  return true;
+}
+
+void AutoComplete::MergeSorted(wxArrayString &list, const wxArrayString &words)
+{
+  if (words.IsEmpty())
+    return;
+
+  wxArrayString merged;
+  merged.Alloc(list.GetCount() + words.GetCount());
+
+  size_t i = 0, j = 0;
+  while ((i < list.GetCount()) || (j < words.GetCount()))
+  {
+    if ((j >= words.GetCount()) ||
+        ((i < list.GetCount()) && (list[i] < words[j])))
+      merged.Add(list[i++]);
+    else
+    {
+      if ((i < list.GetCount()) && (list[i] == words[j]))
+        i++;
+      merged.Add(words[j++]);
+    }
+  }
+  list = merged;
+}
+
+size_t AutoComplete::LowerBound(const wxArrayString &list, const wxString &word)
+{
+  size_t first = 0, count = list.GetCount();
+
+  while (count > 0)
+  {
+    size_t step = count / 2;
+    if (list[first + step] < word)
+    {
+      first += step + 1;
+      count -= step + 1;
+    }
+    else
+      count = step;
+  }
+  return first;
+}
+
+void AutoComplete::SortAndRemoveDuplicates(wxArrayString &list)
+{
+  list.Sort();
+
+  size_t kept = 0;
+  for (size_t i = 0; i < list.GetCount(); i++)
+  {
+    if ((kept == 0) || (list[i] != list[kept - 1]))
+    {
+      if (kept != i)
+        list[kept] = list[i];
+      kept++;
+    }
+  }
+  if (kept < list.GetCount())
+    list.RemoveAt(kept, list.GetCount() - kept);
 }
 
 /// Returns a string array with functions which start with partial.
@@ -136,34 +224,169 @@ wxArrayString AutoComplete::CompleteSymbol(wxString partial, autoCompletionType
   wxArrayString perfectCompletions;
 
   wxASSERT_MSG((type>=command)&&(type<=unit),_("Bug: Autocompletion requested for unknown type of item."));
-  
-  if (type != tmplte) {
-    for (int i=0; i<m_wordList[type].GetCount(); i++)
+
+  // The word lists are sorted and free of duplicates which means that all
+  // words starting with partial are found in a row.
+  const wxArrayString &words = m_wordList[type];
+  for (size_t i = LowerBound(words, partial);
+       (i < words.GetCount()) && (words[i].StartsWith(partial)); i++)
+  {
+    completions.Add(words[i]);
+    if ((type == tmplte) &&
+        (words[i].SubString(0, words[i].Find(wxT("(")) - 1) == partial))
+      perfectCompletions.Add(words[i]);
+  }
+
+  if (perfectCompletions.Count() > 0)
+    return perfectCompletions;
+  return completions;
+}
+
+int AutoComplete::FuzzyScore(const wxString &word, const wxString &partial)
+{
+  size_t wordLength = word.Length(), partialLength = partial.Length();
+  if (partialLength > wordLength)
+    return -1;
+
+  int score = 0;
+  size_t matched = 0;
+  size_t lastMatch = 0;
+  for (size_t i = 0; (i < wordLength) && (matched < partialLength); i++)
+  {
+    if (word[i] != partial[matched])
+      continue;
+
+    if (i == 0)
+      score += 10;
+    else if ((matched > 0) && (lastMatch == i - 1))
+      score += 6;
+    else if (word[i - 1] == wxT('_'))
+      score += 8;
+    else
+      score += 1;
+    lastMatch = i;
+    matched++;
+  }
+
+  if (matched < partialLength)
+    return -1;
+
+  // A word that starts with partial is the best match we can get.
+  if ((partialLength > 0) && (lastMatch == partialLength - 1))
+    score += 20;
+
+  // Of two otherwise equal matches the shorter word is more likely to be meant.
+  int penalty = (wordLength - partialLength) / 4;
+  return MAX(2 * score - penalty, 0);
+}
+
+unsigned long AutoComplete::CharacterMask(const wxString &word)
+{
+  unsigned long mask = 0;
+  for (wxString::const_iterator it = word.begin(); it != word.end(); ++it)
+    mask |= 1UL << (((wxChar) *it) & 31);
+  return mask;
+}
+
+void AutoComplete::UpdateFuzzyIndex(autoCompletionType type)
+{
+  if (m_fuzzyIndexValid[type])
+    return;
+
+  const wxArrayString &words = m_wordList[type];
+  m_characterMasks[type].resize(words.GetCount());
+  m_usageBonus[type].resize(words.GetCount());
+  for (size_t i = 0; i < words.GetCount(); i++)
+  {
+    m_characterMasks[type][i] = CharacterMask(words[i]);
+
+    // Each doubling of the number of uses adds the same bonus.
+    int bonus = 0;
+    std::map<wxString, int>::const_iterator usage = m_usage.find(words[i]);
+    if (usage != m_usage.end())
     {
-      if (m_wordList[type][i].StartsWith(partial) &&
-          completions.Index(m_wordList[type][i]) == wxNOT_FOUND)
-        completions.Add(m_wordList[type][i]);
+      for (int uses = usage->second; uses > 0; uses /= 2)
+        bonus += 4;
     }
+    m_usageBonus[type][i] = bonus;
+  }
+  m_fuzzyIndexValid[type] = true;
+}
+
+wxArrayString AutoComplete::CompleteSymbolFuzzy(wxString partial, autoCompletionType type)
+{
+  wxASSERT_MSG((type>=command)&&(type<=unit),_("Bug: Autocompletion requested for unknown type of item."));
+
+  if (type == tmplte)
+    return CompleteSymbol(partial, type);
+
+  // This is done on every keystroke => the character masks and the usage
+  // bonus of each word are computed only once the word list has changed.
+  UpdateFuzzyIndex(type);
+  unsigned long partialMask = CharacterMask(partial);
+
+  // The negated score of each match and its index in the word list. Sorting
+  // this list gives the best matches first and matches with equal scores in
+  // alphabetical order.
+  std::vector<std::pair<int, size_t> > matches;
+  const wxArrayString &words = m_wordList[type];
+  for (size_t i = 0; i < words.GetCount(); i++)
+  {
+    if ((m_characterMasks[type][i] & partialMask) != partialMask)
+      continue;
+
+    int score = FuzzyScore(words[i], partial);
+    if (score < 0)
+      continue;
+
+    matches.push_back(std::make_pair(-(score + m_usageBonus[type][i]), i));
   }
 
-  else {
-    for (int i=0; i<m_wordList[type].GetCount(); i++)
+  size_t count = MIN(matches.size(), (size_t) AC_FUZZY_MAX_RESULTS);
+  std::partial_sort(matches.begin(), matches.begin() + count, matches.end());
+
+  wxArrayString completions;
+  completions.Alloc(count);
+  for (size_t i = 0; i < count; i++)
+    completions.Add(words[matches[i].second]);
+  return completions;
+}
+
+void AutoComplete::CountUsage(const wxString &command, int weight)
+{
+  wxString symbol;
+  bool inString = false;
+  for (wxString::const_iterator it = command.begin(); it != command.end(); ++it)
+  {
+    wxChar ch = *it;
+    if (inString)
+    {
+      if (ch == wxT('"'))
+        inString = false;
+      continue;
+    }
+
+    if (wxIsalpha(ch) || (ch == wxT('_')) || (ch == wxT('%')) ||
+        ((symbol != wxEmptyString) && wxIsdigit(ch)))
     {
-      wxString templ = m_wordList[type][i];
-      if (templ.StartsWith(partial))
-      {
-        if (completions.Index(templ) == wxNOT_FOUND)
-          completions.Add(templ);
-        if (templ.SubString(0, templ.Find(wxT("(")) - 1) == partial &&
-            perfectCompletions.Index(templ) == wxNOT_FOUND)
-          perfectCompletions.Add(templ);
-      }
+      symbol += ch;
+      continue;
     }
+
+    if (symbol != wxEmptyString)
+    {
+      m_usage[symbol] += weight;
+      symbol = wxEmptyString;
+    }
+    if (ch == wxT('"'))
+      inString = true;
   }
+  if (symbol != wxEmptyString)
+    m_usage[symbol] += weight;
 
-  if (perfectCompletions.Count() > 0)
-    return perfectCompletions;
-  return completions;
+  // The usage bonus of the words has changed.
+  for(int i=command;i<=unit;i++)
+    m_fuzzyIndexValid[i] = false;
 }
 
 void AutoComplete::AddSymbol(wxString fun, autoCompletionType type)
@@ -184,9 +407,18 @@ void AutoComplete::AddSymbol(wxString fun, autoCompletionType type)
     type = unit;
   }
 
+  wxArrayString &words = m_wordList[type];
+
   /// Add symbols
-  if ((type != tmplte) && m_wordList[type].Index(fun, true, true) == wxNOT_FOUND)
-    m_wordList[type].Add(fun);
+  if (type != tmplte)
+  {
+    size_t pos = LowerBound(words, fun);
+    if ((pos == words.GetCount()) || (words[pos] != fun))
+    {
+      words.Insert(fun, pos);
+      m_fuzzyIndexValid[type] = false;
+    }
+  }
 
   /// Add templates - for given function and given argument count we
   /// only add one template. We count the arguments by counting '<'
@@ -194,15 +426,14 @@ void AutoComplete::AddSymbol(wxString fun, autoCompletionType type)
   {
     fun = FixTemplate(fun);
     wxString funName = fun.SubString(0, fun.Find(wxT("(")));
-    int count = fun.Freq('<'), i=0;
-    for (i=0; i<m_wordList[type].GetCount(); i++)
+    int count = fun.Freq('<');
+    for (size_t i = LowerBound(words, funName);
+         (i < words.GetCount()) && (words[i].StartsWith(funName)); i++)
     {
-      wxString t = m_wordList[type][i];
-      if (t.StartsWith(funName) && t.Freq('<') == count)
-        break;
+      if (words[i].Freq('<') == count)
+        return;
     }
-    if (i == m_wordList[type].GetCount())
-      m_wordList[type].Add(fun);
+    words.Insert(fun, LowerBound(words, fun));
   }
 }
 
@@ -25,6 +25,13 @@
 #include <wx/wx.h>
 #include <wx/arrstr.h>
 #include <wx/regex.h>
+#include <map>
+#include <vector>
+
+//! The maximum number of results a fuzzy completion returns
+#define AC_FUZZY_MAX_RESULTS 200
+//! How many uses of a symbol a definition of it counts as
+#define AC_DEFINITION_WEIGHT 5
 
 class AutoComplete
 {
@@ -41,9 +48,51 @@ public:
   bool LoadSymbols(wxString file);
   void AddSymbol(wxString fun, autoCompletionType type=command);
   wxArrayString CompleteSymbol(wxString partial, autoCompletionType type=command);
+  /*! Returns the words that contain the letters of partial in the same order
+
+    The best matches come first: Matches at the start of the word or of a part
+    of it separated by an underscore, letters that follow each other and symbols
+    the user has used often are ranked higher. Templates are completed by
+    CompleteSymbol().
+   */
+  wxArrayString CompleteSymbolFuzzy(wxString partial, autoCompletionType type=command);
+  /*! Count the uses of all symbols in a command
+
+    \param command The command that was sent to maxima
+    \param weight How many uses each occurrence counts as
+   */
+  void CountUsage(const wxString &command, int weight = 1);
   wxString FixTemplate(wxString templ);
 private:
+  //! The index of the first word of the sorted list that doesn't sort before word
+  static size_t LowerBound(const wxArrayString &list, const wxString &word);
+  //! Sort a list of words and remove all words that occur more than once
+  static void SortAndRemoveDuplicates(wxArrayString &list);
+  //! Add a sorted list of words without duplicates to another one
+  static void MergeSorted(wxArrayString &list, const wxArrayString &words);
+  /*! How well word matches partial in a fuzzy search
+
+    \return -1 if word doesn't contain all letters of partial in the right order.
+   */
+  static int FuzzyScore(const wxString &word, const wxString &partial);
+  /*! A bit mask of the characters a word contains
+
+    Bit n is set if the word contains a character whose code is n modulo 32.
+    A word whose mask lacks a bit of the mask of partial cannot match it.
+   */
+  static unsigned long CharacterMask(const wxString &word);
+  //! Recompute m_characterMasks and m_usageBonus for a word list if needed
+  void UpdateFuzzyIndex(autoCompletionType type);
+  //! The words we can complete, sorted and without duplicates
   wxArrayString m_wordList[3];
+  //! How often the user has used each symbol
+  std::map<wxString, int> m_usage;
+  //! The CharacterMask() of each word of m_wordList
+  std::vector<unsigned long> m_characterMasks[3];
+  //! The score each word of m_wordList gets for having been used
+  std::vector<int> m_usageBonus[3];
+  //! false = a word list or m_usage has changed since the last UpdateFuzzyIndex()
+  bool m_fuzzyIndexValid[3];
   wxRegEx m_args;
 };
 
@@ -29,7 +29,6 @@ void AutocompletePopup::UpdateResults()
   wxString partial = m_editor->GetSelectionString();
   
   m_completions = m_autocomplete->CompleteSymbol(partial, m_type);
-  m_completions.Sort();
 
   for (unsigned int i=0; i<m_length; i++)
     Destroy(popid_complete_00 + i);
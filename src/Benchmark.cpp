@@ -0,0 +1,244 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "Benchmark.h"
+#include "Autocomplete.h"
+#include "CellPool.h"
+#include "Dirstructure.h"
+#include "GroupCell.h"
+#include "MathParser.h"
+#include "TextCell.h"
+
+#include <wx/config.h>
+#include <wx/dcmemory.h>
+#include <wx/fileconf.h>
+#include <wx/sstream.h>
+#include <wx/stopwatch.h>
+#include <iostream>
+
+void Benchmark::Run()
+{
+  // Use the default settings, not the ones of the user. Only outputs up to a
+  // length of 5 million characters are displayed, though.
+  wxStringInputStream settings(wxT("showLength=2\n"));
+  wxConfigBase *userConfig = wxConfig::Set(new wxFileConfig(settings));
+
+  CellSizes();
+  ParseAndDelete(100000);
+  ParseTiming();
+  FuzzyCompletion();
+  LargeWorksheet();
+
+  delete wxConfig::Set(userConfig);
+}
+
+wxString Benchmark::GenerateOutput(long elements)
+{
+  wxString xml = wxT("<mth>");
+  for (long i = 0; i < elements; i++)
+  {
+    if (i > 0)
+      xml += wxT("<mo>+</mo>");
+    if (i % 2)
+      xml += wxString::Format(wxT("<mn>%li</mn>"), i);
+    else
+      xml += wxT("<v>x</v>");
+  }
+  xml += wxT("</mth>");
+  return xml;
+}
+
+void Benchmark::DeleteOutput(MathCell *cell)
+{
+  // The same way GroupCell deletes its output.
+  while (cell != NULL)
+  {
+    MathCell *next = cell->m_next;
+    cell->Destroy();
+    delete cell;
+    cell = next;
+  }
+}
+
+void Benchmark::CellSizes()
+{
+  std::cerr << "Cells: sizeof(MathCell) = " << sizeof(MathCell)
+            << " bytes, sizeof(TextCell) = " << sizeof(TextCell) << " bytes\n";
+}
+
+void Benchmark::ParseAndDelete(long elements)
+{
+  wxString xml = GenerateOutput(elements);
+  MathParser parser;
+
+  long blocksBefore = CellPool::BlocksInUse();
+  long allocatedBefore = CellPool::BlocksAllocated();
+  MathCell *cell = parser.ParseLine(xml);
+  long slots = CellPool::SlotsInUse();
+  long blocksParsed = CellPool::BlocksInUse();
+
+  DeleteOutput(cell);
+
+  std::cerr << "CellPool: " << elements << " elements: "
+            << slots << " cells in "
+            << CellPool::BlocksAllocated() - allocatedBefore << " new blocks, "
+            << blocksParsed << " blocks in use while parsed, "
+            << CellPool::BlocksInUse() << " after deleting ("
+            << blocksBefore << " before)\n";
+}
+
+void Benchmark::ParseTiming()
+{
+  MathParser parser;
+  for (long elements = 25000; elements <= 100000; elements *= 2)
+  {
+    wxString xml = GenerateOutput(elements);
+
+    wxStopWatch stopwatch;
+    MathCell *cell = parser.ParseLine(xml);
+    long time = stopwatch.Time();
+
+    DeleteOutput(cell);
+
+    std::cerr << "MathParser: " << elements << " elements: "
+              << time << " ms ("
+              << 1000.0 * time / elements << " ms per 1000 elements)\n";
+  }
+}
+
+void Benchmark::FuzzyCompletion()
+{
+  AutoComplete autocomplete;
+  Dirstructure dirstructure;
+  if (!autocomplete.LoadSymbols(dirstructure.AutocompleteFile()))
+  {
+    std::cerr << "AutoComplete: cannot read the list of symbols\n";
+    return;
+  }
+
+  // The list of symbols maxima and its packages know has less entries than a
+  // worksheet that loads many packages and defines many functions can end up
+  // with => pad it with words made from two of the known symbols.
+  wxArrayString symbols = autocomplete.CompleteSymbol(wxEmptyString);
+  size_t known = symbols.GetCount();
+  for (size_t i = 0; (known > 0) && (symbols.GetCount() < BENCHMARK_SYMBOLS); i++)
+  {
+    wxString word = symbols[i % known] + wxT("_") + symbols[(i / known + i * 7919 + 1) % known];
+    autocomplete.AddSymbol(word);
+    symbols.Add(word);
+  }
+
+  // Give every 4th symbol a different number of uses so the usage bonus is
+  // part of what is measured.
+  for (size_t i = 0; i < symbols.GetCount(); i += 4)
+    autocomplete.CountUsage(symbols[i], i % 100 + 1);
+
+  // The first completion after the word list has changed builds the index.
+  wxStopWatch indexTime;
+  autocomplete.CompleteSymbolFuzzy(wxT("x"));
+  std::cerr << "AutoComplete: first completion after a change of the symbols: "
+            << indexTime.TimeInMicro().ToDouble() / 1000.0 << " ms\n";
+
+  const wxChar *partials[] = {wxT("i"), wxT("int"), wxT("plt2d"), wxT("xyz")};
+  const int runs = 100;
+  for (size_t i = 0; i < sizeof(partials) / sizeof(partials[0]); i++)
+  {
+    size_t results = 0;
+    wxStopWatch stopwatch;
+    for (int run = 0; run < runs; run++)
+      results = autocomplete.CompleteSymbolFuzzy(partials[i]).GetCount();
+    double time = stopwatch.TimeInMicro().ToDouble() / runs / 1000.0;
+
+    std::cerr << "AutoComplete: fuzzy completion of \""
+              << wxString(partials[i]).mb_str() << "\" over "
+              << symbols.GetCount() << " symbols: "
+              << results << " results in " << time << " ms"
+              << ((time < 1.0) ? "" : " (slower than 1 ms)") << "\n";
+  }
+}
+
+void Benchmark::LargeWorksheet()
+{
+  // A cell of code as it is typically found in a worksheet: 10 lines with
+  // 50 characters each.
+  wxString line = wxT("f(x) := block([a: x^2, b: sin(x)], a*b + cos(a));\n");
+  wxString code;
+  for (int i = 0; i < 10; i++)
+    code += line;
+
+  long cells = BENCHMARK_WORKSHEET_BYTES / code.Length();
+  GroupCell *tree = NULL, *last = NULL;
+  for (long i = 0; i < cells; i++)
+  {
+    GroupCell *cell = new GroupCell(GC_TYPE_CODE, code);
+    if (last == NULL)
+      tree = cell;
+    else
+    {
+      last->m_next = last->m_nextToDraw = cell;
+      cell->m_previous = cell->m_previousToDraw = last;
+    }
+    last = cell;
+  }
+
+  wxBitmap bitmap(1000, BENCHMARK_VIEWPORT_HEIGHT);
+  wxMemoryDC dc;
+  dc.SelectObject(bitmap);
+  CellParser parser(dc);
+  parser.SetClientWidth(1000 - MC_GROUP_LEFT_INDENT - MC_BASE_INDENT);
+  parser.SetProgressiveLayout(true);
+  int d_fontsize = parser.GetDefaultFontSize();
+  int m_fontsize = parser.GetMathFontSize();
+
+  // The same steps as MathCtrl::Recalculate() and UpdateCellPositions() for a
+  // file that has just been opened.
+  wxStopWatch estimateTime;
+  int y = MC_BASE_INDENT;
+  for (GroupCell *tmp = tree; tmp != NULL; tmp = dynamic_cast<GroupCell*>(tmp->m_next))
+  {
+    tmp->EstimateSize(parser, d_fontsize, m_fontsize);
+    y += tmp->GetMaxCenter();
+    tmp->m_currentPoint.x = MC_GROUP_LEFT_INDENT;
+    tmp->m_currentPoint.y = y;
+    y += tmp->GetMaxDrop() + MC_GROUP_SKIP;
+  }
+  long estimate = estimateTime.Time();
+
+  // The same as MathCtrl::RecalculateVisible() for a viewport at the top.
+  wxStopWatch viewportTime;
+  int height = MC_BASE_INDENT;
+  long laidOut = 0;
+  for (GroupCell *tmp = tree; (tmp != NULL) && (height <= BENCHMARK_VIEWPORT_HEIGHT);
+       tmp = dynamic_cast<GroupCell*>(tmp->m_next))
+  {
+    tmp->Recalculate(parser, d_fontsize, m_fontsize);
+    height += tmp->GetMaxCenter() + tmp->GetMaxDrop() + MC_GROUP_SKIP;
+    laidOut++;
+  }
+  long viewport = viewportTime.Time();
+
+  std::cerr << "Layout: worksheet with " << cells << " cells and "
+            << BENCHMARK_WORKSHEET_BYTES / (1024 * 1024) << " MB of input: "
+            << "estimating all cells " << estimate << " ms, laying out the "
+            << laidOut << " cells in the viewport " << viewport << " ms"
+            << ((estimate + viewport < 1000) ? "" : " (slower than 1 s)") << "\n";
+
+  DeleteOutput(tree);
+}
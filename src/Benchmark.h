@@ -0,0 +1,91 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+
+  Benchmarks that can be run by starting wxMaxima with --benchmark
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <wx/wx.h>
+
+#include "MathCell.h"
+
+//! The number of symbols the fuzzy completion benchmark completes from
+#define BENCHMARK_SYMBOLS 20000
+//! The size of the input text of the worksheet the layout benchmark opens
+#define BENCHMARK_WORKSHEET_BYTES (50 * 1024 * 1024)
+//! The height of the viewport the layout benchmark lays out
+#define BENCHMARK_VIEWPORT_HEIGHT 1000
+
+/*! Measurements of the parts of wxMaxima that have to cope with big worksheets
+
+  All results are written to stderr. The benchmarks don't need maxima and
+  don't open a window.
+ */
+class Benchmark
+{
+public:
+  //! Run all benchmarks
+  static void Run();
+
+private:
+  /*! Generate the xml maxima sends for a list with the given number of elements
+
+    The list is a sum of numbers and variables, which is the kind of output
+    that is made of huge numbers of small cells.
+   */
+  static wxString GenerateOutput(long elements);
+  //! Delete a list of cells MathParser has returned
+  static void DeleteOutput(MathCell *cell);
+  /*! Parse a huge output and delete it again
+
+    Reports how many blocks the CellPool requests and how many it gives back.
+   */
+  static void ParseAndDelete(long elements);
+  /*! Measure how the time MathParser needs grows with the length of the output
+
+    Parses outputs with 25000, 50000 and 100000 elements. If parsing is linear
+    in the number of cells the time per element stays the same, if appending
+    to the list of cells got quadratic again it doubles with every step.
+   */
+  static void ParseTiming();
+  //! Report how much memory every cell needs
+  static void CellSizes();
+  /*! Measure how long a fuzzy completion over all known symbols takes
+
+    It is done on every keystroke while the content assistant is open, so it
+    should take less than a millisecond.
+   */
+  static void FuzzyCompletion();
+  /*! Measure how long it takes until a huge worksheet can be displayed
+
+    Generates a worksheet with BENCHMARK_WORKSHEET_BYTES of input and times
+    what MathCtrl::Recalculate() does after a file has been opened: Estimating
+    the size of every cell and laying out the cells in the viewport. The target
+    is less than a second. Reading and parsing the file isn't part of the
+    measurement.
+   */
+  static void LargeWorksheet();
+};
+
+#endif // BENCHMARK_H
@@ -24,18 +24,11 @@
 #include <wx/config.h>
 #include "MathCell.h"
 
-CellParser::CellParser(wxDC& dc) : m_dc(dc)
+ParserStyle *ParserStyle::m_current = NULL;
+
+ParserStyle::ParserStyle()
 {
-  m_scale = 1.0;
-  m_zoomFactor = 1.0; // affects returned fontsizes
-  m_top = -1;
-  m_bottom = -1;
-  m_forceUpdate = false;
-  m_indent = MC_GROUP_LEFT_INDENT;
-  m_changeAsterisk = false;
-  m_outdated = false;
   m_TeXFonts = false;
-
   if (wxFontEnumerator::IsValidFacename(m_fontCMEX = wxT("jsMath-cmex10")) &&
       wxFontEnumerator::IsValidFacename(m_fontCMSY = wxT("jsMath-cmsy10")) &&
       wxFontEnumerator::IsValidFacename(m_fontCMRI = wxT("jsMath-cmr10")) &&
@@ -52,48 +45,73 @@ CellParser::CellParser(wxDC& dc) : m_dc(dc)
   ReadStyle();
 }
 
+const ParserStyle *ParserStyle::Get()
+{
+  if (m_current == NULL)
+    m_current = new ParserStyle;
+  return m_current;
+}
+
+void ParserStyle::ClearCache()
+{
+  wxDELETE(m_current);
+}
+
+CellParser::CellParser(wxDC& dc) : m_dc(dc)
+{
+  m_scale = 1.0;
+  Init();
+}
+
 CellParser::CellParser(wxDC& dc, double scale) : m_dc(dc)
 {
   m_scale = scale;
+  Init();
+}
+
+void CellParser::Init()
+{
   m_zoomFactor = 1.0; // affects returned fontsizes
   m_top = -1;
   m_bottom = -1;
+  m_left = -1;
+  m_right = -1;
   m_forceUpdate = false;
+  m_progressiveLayout = false;
+  m_layoutIncomplete = false;
   m_indent = MC_GROUP_LEFT_INDENT;
   m_changeAsterisk = false;
   m_outdated = false;
-  m_TeXFonts = false;
+  m_lastMetrics = NULL;
+  m_style = ParserStyle::Get();
 
-  if (wxFontEnumerator::IsValidFacename(m_fontCMEX = wxT("jsMath-cmex10")) &&
-      wxFontEnumerator::IsValidFacename(m_fontCMSY = wxT("jsMath-cmsy10")) &&
-      wxFontEnumerator::IsValidFacename(m_fontCMRI = wxT("jsMath-cmr10")) &&
-      wxFontEnumerator::IsValidFacename(m_fontCMMI = wxT("jsMath-cmmi10")) &&
-      wxFontEnumerator::IsValidFacename(m_fontCMTI = wxT("jsMath-cmti10")))
-  {
-    m_TeXFonts = true;
-    wxConfig::Get()->Read(wxT("usejsmath"), &m_TeXFonts);
-  }
-
-  m_keepPercent = true;
-  wxConfig::Get()->Read(wxT("keepPercent"), &m_keepPercent);
-
-  ReadStyle();
+  m_dc.SetPen(*(wxThePenList->FindOrCreatePen(m_style->m_styles[TS_DEFAULT].color, 1, wxPENSTYLE_SOLID)));
 }
 
 CellParser::~CellParser()
 {}
 
+void CellParser::GetTextExtent(const wxString &text, wxCoord *width, wxCoord *height)
+{
+  if ((m_lastMetrics == NULL) || !(m_dc.GetFont() == m_lastFont))
+  {
+    m_lastFont = m_dc.GetFont();
+    m_lastMetrics = GlyphMetrics::Get(m_dc);
+  }
+  m_lastMetrics->GetTextExtent(m_dc, text, width, height);
+}
+
 wxString CellParser::GetFontName(int type)
 {
   if (type == TS_TITLE || type == TS_SUBSECTION || type == TS_SUBSUBSECTION || type == TS_SECTION || type == TS_TEXT)
-    return m_styles[type].font;
+    return m_style->m_styles[type].font;
   else if (type == TS_NUMBER || type == TS_VARIABLE || type == TS_FUNCTION ||
       type == TS_SPECIAL_CONSTANT || type == TS_STRING)
-    return m_mathFontName;
-  return m_fontName;
+    return m_style->m_mathFontName;
+  return m_style->m_fontName;
 }
 
-void CellParser::ReadStyle()
+void ParserStyle::ReadStyle()
 {
   wxConfigBase* config = wxConfig::Get();
 
@@ -360,27 +378,25 @@ void CellParser::ReadStyle()
 
 
 #undef READ_STYLES
-
-  m_dc.SetPen(*(wxThePenList->FindOrCreatePen(m_styles[TS_DEFAULT].color, 1, wxPENSTYLE_SOLID)));
 }
 
 wxFontWeight CellParser::IsBold(int st)
 {
-  if (m_styles[st].bold)
+  if (m_style->m_styles[st].bold)
     return wxFONTWEIGHT_BOLD;
   return wxFONTWEIGHT_NORMAL;
 }
 
 wxFontStyle CellParser::IsItalic(int st)
 {
-  if (m_styles[st].italic)
+  if (m_style->m_styles[st].italic)
     return wxFONTSTYLE_SLANT;
   return wxFONTSTYLE_NORMAL;
 }
 
 bool CellParser::IsUnderlined(int st)
 {
-  return m_styles[st].underlined;
+  return m_style->m_styles[st].underlined;
 }
 
 wxString CellParser::GetSymbolFontName()
@@ -388,14 +404,14 @@ wxString CellParser::GetSymbolFontName()
 #if defined __WXMSW__
   return wxT("Symbol");
 #endif
-  return m_fontName;
+  return m_style->m_fontName;
 }
 
 wxColour CellParser::GetColor(int st)
 {
   if (m_outdated)
-    return m_styles[TS_OUTDATED].color;
-  return m_styles[st].color;
+    return m_style->m_styles[TS_OUTDATED].color;
+  return m_style->m_styles[st].color;
 }
 
 /*
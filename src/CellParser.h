@@ -25,9 +25,51 @@
 #include <wx/fontenum.h>
 
 #include "TextStyle.h"
+#include "GlyphMetrics.h"
 
 #include "Setup.h"
 
+/*! The fonts and text styles all CellParsers share
+
+  A CellParser is created for every repaint, every recalculation and every
+  printed page. Probing which TeX fonts are installed and reading the dozens of
+  style settings from the configuration every time would make this expensive.
+  So this is done only once and the result is shared between all CellParsers
+  until the configuration changes.
+ */
+class ParserStyle
+{
+public:
+  /*! Get the style that matches the current configuration
+
+    It is read from the configuration on the first request and kept until
+    ClearCache() is called.
+   */
+  static const ParserStyle *Get();
+  /*! Forget the style, for example because the configuration has changed
+
+    No CellParser may be in use while this function is called.
+   */
+  static void ClearCache();
+
+  wxString m_fontName;
+  int m_defaultFontSize, m_mathFontSize;
+  wxString m_mathFontName;
+  //! Are the jsMath TeX fonts installed and do we want to use them?
+  bool m_TeXFonts;
+  bool m_keepPercent;
+  wxString m_fontCMRI, m_fontCMSY, m_fontCMEX, m_fontCMMI, m_fontCMTI;
+  wxFontEncoding m_fontEncoding;
+  style m_styles[STYLE_NUM];
+
+private:
+  //! Probes the fonts and reads the styles from the configuration
+  ParserStyle();
+  void ReadStyle();
+  //! The style all CellParsers currently use
+  static ParserStyle *m_current;
+};
+
 class CellParser
 {
 public:
@@ -38,6 +80,12 @@ public:
   void SetScale(double scale) { m_scale = scale; }
   double GetScale() { return m_scale; }
   wxDC& GetDC() { return m_dc; }
+  /*! Get the extent of a text in the font that currently is selected into the DC
+
+    Uses the glyph-metrics table of the font and falls back to asking the DC
+    only for text that needs complex shaping.
+   */
+  void GetTextExtent(const wxString &text, wxCoord *width, wxCoord *height);
   void SetBounds(int top, int bottom) {
     m_top = top;
     m_bottom = bottom;
@@ -50,13 +98,25 @@ public:
   {
     return m_bottom;
   }
+  //! Set the horizontal range of the worksheet that is visible
+  void SetHorizontalBounds(int left, int right) {
+    m_left = left;
+    m_right = right;
+  }
+  int GetLeft()
+  {
+    return m_left;
+  }
+  int GetRight()
+  {
+    return m_right;
+  }
   wxString GetFontName(int type = TS_DEFAULT);
   wxString GetSymbolFontName();
   wxColour GetColor(int st);
   wxFontWeight IsBold(int st);
   wxFontStyle IsItalic(int st);
   bool IsUnderlined(int st);
-  void ReadStyle();
   void SetForceUpdate(bool force)
   {
     m_forceUpdate = force;
@@ -65,9 +125,20 @@ public:
   {
     return m_forceUpdate;
   }
+  /*! Allow cells to lay out only part of their contents in one go
+
+    Only the worksheet allows this: It lays out the rest in its idle loop.
+    Printouts and bitmaps need the complete layout at once.
+   */
+  void SetProgressiveLayout(bool progressive) { m_progressiveLayout = progressive; }
+  bool ProgressiveLayout() { return m_progressiveLayout; }
+  //! Called by a cell that has left part of its contents unmeasured
+  void SetLayoutIncomplete(bool incomplete) { m_layoutIncomplete = incomplete; }
+  //! Has a cell left part of its contents unmeasured?
+  bool LayoutIncomplete() { return m_layoutIncomplete; }
   wxFontEncoding GetFontEncoding()
   {
-    return m_fontEncoding;
+    return m_style->m_fontEncoding;
   }
   bool GetChangeAsterisk()
   {
@@ -81,40 +152,43 @@ public:
   void SetIndent(int indent) { m_indent = indent; }
   void SetClientWidth(int width) { m_clientWidth = width; }
   int GetClientWidth() { return m_clientWidth; }
-  int GetDefaultFontSize() { return int(m_zoomFactor * double(m_defaultFontSize)); }
-  int GetMathFontSize() { return int(m_zoomFactor * double(m_mathFontSize)); }
+  int GetDefaultFontSize() { return int(m_zoomFactor * double(m_style->m_defaultFontSize)); }
+  int GetMathFontSize() { return int(m_zoomFactor * double(m_style->m_mathFontSize)); }
   int GetFontSize(int st)
   {
     if (st == TS_TEXT || st == TS_SUBSUBSECTION || st == TS_SUBSECTION || st == TS_SECTION || st == TS_TITLE)
-      return int(m_zoomFactor * double(m_styles[st].fontSize));
+      return int(m_zoomFactor * double(m_style->m_styles[st].fontSize));
     return 0;
   }
   void Outdated(bool outdated) { m_outdated = outdated; }
-  bool CheckTeXFonts() { return m_TeXFonts; }
-  bool CheckKeepPercent() { return m_keepPercent; }
-  wxString GetTeXCMRI() { return m_fontCMRI; }
-  wxString GetTeXCMSY() { return m_fontCMSY; }
-  wxString GetTeXCMEX() { return m_fontCMEX; }
-  wxString GetTeXCMMI() { return m_fontCMMI; }
-  wxString GetTeXCMTI() { return m_fontCMTI; }
+  bool CheckTeXFonts() { return m_style->m_TeXFonts; }
+  bool CheckKeepPercent() { return m_style->m_keepPercent; }
+  wxString GetTeXCMRI() { return m_style->m_fontCMRI; }
+  wxString GetTeXCMSY() { return m_style->m_fontCMSY; }
+  wxString GetTeXCMEX() { return m_style->m_fontCMEX; }
+  wxString GetTeXCMMI() { return m_style->m_fontCMMI; }
+  wxString GetTeXCMTI() { return m_style->m_fontCMTI; }
 private:
   int m_indent;
   double m_scale;
   double m_zoomFactor;
   wxDC& m_dc;
+  //! The font the last glyph-metrics table was requested for
+  wxFont m_lastFont;
+  //! The glyph-metrics table for m_lastFont
+  GlyphMetrics *m_lastMetrics;
   int m_top, m_bottom;
-  wxString m_fontName;
-  int m_defaultFontSize, m_mathFontSize;
-  wxString m_mathFontName;
+  int m_left, m_right;
   bool m_forceUpdate;
+  bool m_progressiveLayout;
+  bool m_layoutIncomplete;
   bool m_changeAsterisk;
   bool m_outdated;
-  bool m_TeXFonts;
-  bool m_keepPercent;
-  wxString m_fontCMRI, m_fontCMSY, m_fontCMEX, m_fontCMMI, m_fontCMTI;
   int m_clientWidth;
-  wxFontEncoding m_fontEncoding;
-  style m_styles[STYLE_NUM];
+  //! The fonts and styles shared by all CellParsers
+  const ParserStyle *m_style;
+  //! Initialization common to both constructors
+  void Init();
 };
 
 #endif // CELLPARSER_H
@@ -0,0 +1,135 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "CellPool.h"
+
+#include <new>
+
+CellPool::Block *CellPool::m_available[CELLPOOL_MAX_SIZE / CELLPOOL_GRANULARITY];
+std::map<char *, CellPool::Block *> CellPool::m_blocks;
+long CellPool::m_blocksInUse = 0;
+long CellPool::m_blocksAllocated = 0;
+long CellPool::m_blocksFreed = 0;
+long CellPool::m_slotsInUse = 0;
+
+void CellPool::Link(Block *block)
+{
+  block->prev = NULL;
+  block->next = m_available[block->sizeClass];
+  if (block->next != NULL)
+    block->next->prev = block;
+  m_available[block->sizeClass] = block;
+}
+
+void CellPool::Unlink(Block *block)
+{
+  if (block->prev != NULL)
+    block->prev->next = block->next;
+  else
+    m_available[block->sizeClass] = block->next;
+  if (block->next != NULL)
+    block->next->prev = block->prev;
+  block->prev = block->next = NULL;
+}
+
+void CellPool::Grow(int sizeClass)
+{
+  size_t slotSize = (sizeClass + 1) * CELLPOOL_GRANULARITY;
+  char *mem = static_cast<char *>(::operator new(CELLPOOL_BLOCK_SIZE));
+  Block *block = reinterpret_cast<Block *>(mem);
+  block->freeSlots = NULL;
+  block->used = 0;
+  block->sizeClass = sizeClass;
+
+  // The slots start behind the header, aligned to the granularity.
+  size_t first = (sizeof(Block) + CELLPOOL_GRANULARITY - 1) /
+    CELLPOOL_GRANULARITY * CELLPOOL_GRANULARITY;
+  for (size_t pos = first; pos + slotSize <= CELLPOOL_BLOCK_SIZE; pos += slotSize)
+  {
+    FreeSlot *slot = reinterpret_cast<FreeSlot *>(mem + pos);
+    slot->next = block->freeSlots;
+    block->freeSlots = slot;
+  }
+
+  m_blocks[mem] = block;
+  Link(block);
+  m_blocksInUse++;
+  m_blocksAllocated++;
+}
+
+CellPool::Block *CellPool::BlockOf(void *p)
+{
+  // The block a slot belongs to is the last one that starts before it.
+  std::map<char *, Block *>::iterator it = m_blocks.upper_bound(static_cast<char *>(p));
+  --it;
+  return it->second;
+}
+
+void *CellPool::Allocate(size_t size)
+{
+  if ((size == 0) || (size > CELLPOOL_MAX_SIZE))
+    return ::operator new(size);
+
+  int sizeClass = (size - 1) / CELLPOOL_GRANULARITY;
+  if (m_available[sizeClass] == NULL)
+    Grow(sizeClass);
+
+  Block *block = m_available[sizeClass];
+  FreeSlot *slot = block->freeSlots;
+  block->freeSlots = slot->next;
+  block->used++;
+  if (block->freeSlots == NULL)
+    Unlink(block);
+  m_slotsInUse++;
+  return slot;
+}
+
+void CellPool::Free(void *p, size_t size)
+{
+  if (p == NULL)
+    return;
+
+  if ((size == 0) || (size > CELLPOOL_MAX_SIZE))
+  {
+    ::operator delete(p);
+    return;
+  }
+
+  Block *block = BlockOf(p);
+  FreeSlot *slot = static_cast<FreeSlot *>(p);
+  // A block that was full gets unused slots again.
+  if (block->freeSlots == NULL)
+    Link(block);
+  slot->next = block->freeSlots;
+  block->freeSlots = slot;
+  block->used--;
+  m_slotsInUse--;
+
+  // Keep the last block with unused slots of each size for the next cells.
+  if ((block->used == 0) &&
+      ((block->prev != NULL) || (block->next != NULL)))
+  {
+    Unlink(block);
+    m_blocks.erase(reinterpret_cast<char *>(block));
+    ::operator delete(block);
+    m_blocksInUse--;
+    m_blocksFreed++;
+  }
+}
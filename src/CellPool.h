@@ -0,0 +1,103 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+
+  The memory pool all cells of the worksheet are allocated from.
+ */
+
+#ifndef CELLPOOL_H
+#define CELLPOOL_H
+
+#include <cstddef>
+#include <map>
+
+//! The granularity of the slot sizes the pool hands out
+#define CELLPOOL_GRANULARITY 16
+//! Objects bigger than this are allocated from the heap directly
+#define CELLPOOL_MAX_SIZE 512
+//! The size of the blocks the pool requests from the heap
+#define CELLPOOL_BLOCK_SIZE 65536
+
+/*! A pool of fixed-size slots the cells are allocated from
+
+  A long output of maxima consists of hundreds of thousands of small cells that
+  all are created by MathParser and that are all deleted at once when the
+  GroupCell they belong to is re-evaluated. Allocating each of them from the
+  heap is slow and fragments the heap. Instead we carve big blocks into slots
+  of the size of the cells. Each block keeps a list of its unused slots so
+  deleting a cell only puts its slot back into the block it came from.
+
+  A block that no more contains any cell is returned to the heap as soon as
+  another block of the same slot size still has unused slots: Deleting a big
+  output therefore gives back its memory, but a worksheet that creates and
+  deletes a few cells all the time doesn't allocate and free a block every
+  time. All of this happens in the GUI thread, only, so no locking is needed.
+ */
+class CellPool
+{
+public:
+  //! Get a slot that is at least size bytes long
+  static void *Allocate(size_t size);
+  //! Put back a slot that was obtained from Allocate(size)
+  static void Free(void *p, size_t size);
+
+  //! The number of blocks that currently are allocated from the heap
+  static long BlocksInUse() { return m_blocksInUse; }
+  //! The number of blocks that have been allocated from the heap so far
+  static long BlocksAllocated() { return m_blocksAllocated; }
+  //! The number of blocks that have been returned to the heap so far
+  static long BlocksFreed() { return m_blocksFreed; }
+  //! The number of slots that currently are in use
+  static long SlotsInUse() { return m_slotsInUse; }
+
+private:
+  //! A slot that currently is unused
+  struct FreeSlot
+  {
+    FreeSlot *next;
+  };
+  //! The header at the beginning of each block
+  struct Block
+  {
+    //! The neighbours in the list of blocks of this size class with unused slots
+    Block *prev, *next;
+    //! The unused slots of this block
+    FreeSlot *freeSlots;
+    //! The number of slots of this block that are in use
+    int used;
+    int sizeClass;
+  };
+  //! Carve a new block into slots of the size class sizeClass
+  static void Grow(int sizeClass);
+  //! Find the block a slot belongs to
+  static Block *BlockOf(void *p);
+  //! Add a block to the list of blocks with unused slots
+  static void Link(Block *block);
+  //! Remove a block from the list of blocks with unused slots
+  static void Unlink(Block *block);
+  //! For each size class the blocks that contain unused slots
+  static Block *m_available[CELLPOOL_MAX_SIZE / CELLPOOL_GRANULARITY];
+  //! All blocks, sorted by their address
+  static std::map<char *, Block *> m_blocks;
+  static long m_blocksInUse, m_blocksAllocated, m_blocksFreed, m_slotsInUse;
+};
+
+#endif // CELLPOOL_H
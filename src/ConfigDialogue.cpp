@@ -27,6 +27,8 @@
 
 #include "ConfigDialogue.h"
 #include "MathCell.h"
+#include "EditorCell.h"
+#include "MathCtrl.h"
 
 #include <wx/config.h>
 #include <wx/fileconf.h>
@@ -138,6 +140,7 @@ void ConfigDialogue::SetProperties()
 
   m_showUserDefinedLabels->SetToolTip(_("If a command begins with a label followed by a : wxMaxima will show this label instead of the \%o style label maxima has automatically assigned to the same output cell."));
   m_abortOnError->SetToolTip(_("If multiple cells are evaluated in one go: Abort evaluation if wxMaxima detects that maxima has encountered any error."));
+  m_standbyMaxima->SetToolTip(_("Start a second maxima process in the background that is ready to take over as soon as maxima is restarted or has crashed. Makes restarting maxima nearly instantaneous at the cost of the memory of an additional maxima process."));
   m_pollStdOut->SetToolTip(_("Once the local network link between maxima and wxMaxima has been established maxima has no reason to send any messages using the system's stdout stream so all this stream transport should be a greeting message; The lisp running maxima will send eventual error messages using the system's stderr stream instead. If this box is checked we will nonetheless watch maxima's stdout stream for messages."));
   m_maximaProgram->SetToolTip(_("Enter the path to the Maxima executable."));
   m_additionalParameters->SetToolTip(_("Additional parameters for Maxima"
@@ -174,6 +177,8 @@ void ConfigDialogue::SetProperties()
   m_changeAsterisk->SetToolTip(_("Use centered dot character for multiplication"));
   m_defaultPort->SetToolTip(_("The default port used for communication between Maxima and wxMaxima."));
   m_undoLimit->SetToolTip(_("Save only this number of actions in the undo buffer. 0 means: save an infinite number of actions."));
+  m_undoMemory->SetToolTip(_("The memory the undo buffer of each input cell may use in kilobytes. 0 means: no limit."));
+  m_treeUndoMemory->SetToolTip(_("The memory the undo buffer for adding and deleting cells of the worksheet may use in kilobytes. 0 means: no limit."));
 
   #ifdef __WXMSW__
   m_wxcd->SetToolTip(_("Automatically change maxima's working directory to the one the current document is in: "
@@ -187,7 +192,7 @@ void ConfigDialogue::SetProperties()
   // The default values for all config items that will be used if there is no saved
   // configuration data for this item.
   bool match = true, savePanes = true, UncompressedWXMX=true;
-  bool fixedFontTC = true, changeAsterisk = false, usejsmath = true, keepPercent = true, abortOnError = true, pollStdOut = false;
+  bool fixedFontTC = true, changeAsterisk = false, usejsmath = true, keepPercent = true, abortOnError = true, pollStdOut = false, standbyMaxima = false;
   bool enterEvaluates = false, saveUntitled = true,
     openHCaret = false, AnimateLaTeX = true, TeXExponentsAfterSubscript=false,
     usePartialForDiff = false,
@@ -196,6 +201,8 @@ void ConfigDialogue::SetProperties()
   bool insertAns = true;
   int labelWidth = 4;
   int  undoLimit = 0;
+  int  undoMemory = EDITORCELL_UNDO_MEMORY_DEFAULT;
+  int  treeUndoMemory = MATHCTRL_UNDO_MEMORY_DEFAULT;
   int showLength = 0;
   int autosubscript = 1;
   int  bitmapScale = 3;
@@ -256,6 +263,8 @@ void ConfigDialogue::SetProperties()
   config->Read(wxT("insertAns"), &insertAns);
   config->Read(wxT("labelWidth"), &labelWidth);
   config->Read(wxT("undoLimit"), &undoLimit);
+  config->Read(wxT("undoMemory"), &undoMemory);
+  config->Read(wxT("treeUndoMemory"), &treeUndoMemory);
   config->Read(wxT("bitmapScale"), &bitmapScale);
   config->Read(wxT("fixReorderedIndices"), &fixReorderedIndices);
   config->Read(wxT("showUserDefinedLabels"), &showUserDefinedLabels);
@@ -263,6 +272,7 @@ void ConfigDialogue::SetProperties()
   config->Read(wxT("keepPercent"), &keepPercent);
   config->Read(wxT("abortOnError"), &abortOnError);
   config->Read(wxT("pollStdOut"), &pollStdOut);
+  config->Read(wxT("standbyMaxima"), &standbyMaxima);
   unsigned int i = 0;
   for (i = 0; i < LANGUAGE_NUMBER; i++)
     if (langs[i] == lang)
@@ -322,6 +332,8 @@ void ConfigDialogue::SetProperties()
   m_insertAns->SetValue(insertAns);
   m_labelWidth->SetValue(labelWidth);
   m_undoLimit->SetValue(undoLimit);
+  m_undoMemory->SetValue(undoMemory);
+  m_treeUndoMemory->SetValue(treeUndoMemory);
   m_bitmapScale->SetValue(bitmapScale);
   m_fixReorderedIndices->SetValue(fixReorderedIndices);
   m_showUserDefinedLabels->SetValue(showUserDefinedLabels);
@@ -330,6 +342,7 @@ void ConfigDialogue::SetProperties()
   m_keepPercentWithSpecials->SetValue(keepPercent);
   m_abortOnError->SetValue(abortOnError);
   m_pollStdOut->SetValue(pollStdOut);
+  m_standbyMaxima->SetValue(standbyMaxima);
   m_defaultFramerate->SetValue(defaultFramerate);
   m_defaultPlotWidth->SetValue(defaultPlotWidth);
   m_defaultPlotHeight->SetValue(defaultPlotHeight);
@@ -537,6 +550,16 @@ wxPanel* ConfigDialogue::CreateOptionsPanel()
   grid_sizer->Add(ul, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
   grid_sizer->Add(m_undoLimit, 0, wxALL, 5);
 
+  wxStaticText* um = new wxStaticText(panel, -1, _("Undo memory per cell (kB, 0 for no limit)"));
+  m_undoMemory = new wxSpinCtrl(panel, -1, wxEmptyString, wxDefaultPosition, wxSize(100, -1), wxSP_ARROW_KEYS, 0, 1048576);
+  grid_sizer->Add(um, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  grid_sizer->Add(m_undoMemory, 0, wxALL, 5);
+
+  wxStaticText* tum = new wxStaticText(panel, -1, _("Worksheet undo memory (kB, 0 for no limit)"));
+  m_treeUndoMemory = new wxSpinCtrl(panel, -1, wxEmptyString, wxDefaultPosition, wxSize(100, -1), wxSP_ARROW_KEYS, 0, 1048576);
+  grid_sizer->Add(tum, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+  grid_sizer->Add(m_treeUndoMemory, 0, wxALL, 5);
+
   wxStaticText* df = new wxStaticText(panel, -1, _("Default animation framerate:"));
   m_defaultFramerate = new wxSpinCtrl(panel, -1, wxEmptyString, wxDefaultPosition, wxSize(100, -1), wxSP_ARROW_KEYS, 1, 200);
   grid_sizer->Add(df, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
@@ -615,6 +638,10 @@ wxPanel* ConfigDialogue::CreateMaximaPanel()
   sizer->Add(m_abortOnError,0,wxALL, 5);
   sizer->Add(10,10);
   
+  m_standbyMaxima = new wxCheckBox(panel, -1, _("Keep a maxima ready for restarts"));
+  sizer->Add(m_standbyMaxima,0,wxALL, 5);
+  sizer->Add(10,10);
+
   m_pollStdOut = new wxCheckBox(panel, -1, _("Debug: Watch maxima's stdout stream"));
   sizer->Add(m_pollStdOut,0,wxALL, 5);
   sizer->Add(10,10);
@@ -751,6 +778,7 @@ void ConfigDialogue::WriteSettings()
   wxConfig *config = (wxConfig *)wxConfig::Get();
   config->Write(wxT("abortOnError"), m_abortOnError->GetValue());
   config->Write(wxT("pollStdOut"), m_pollStdOut->GetValue());
+  config->Write(wxT("standbyMaxima"), m_standbyMaxima->GetValue());
   config->Write(wxT("maxima"), m_maximaProgram->GetValue());
   config->Write(wxT("parameters"), m_additionalParameters->GetValue());
   config->Write(wxT("fontSize"), m_fontSize);
@@ -766,6 +794,8 @@ void ConfigDialogue::WriteSettings()
   config->Write(wxT("insertAns"), m_insertAns->GetValue());
   config->Write(wxT("labelWidth"), m_labelWidth->GetValue());
   config->Write(wxT("undoLimit"), m_undoLimit->GetValue());
+  config->Write(wxT("undoMemory"), m_undoMemory->GetValue());
+  config->Write(wxT("treeUndoMemory"), m_treeUndoMemory->GetValue());
   config->Write(wxT("bitmapScale"), m_bitmapScale->GetValue());
   config->Write(wxT("fixReorderedIndices"), m_fixReorderedIndices->GetValue());
   config->Write(wxT("showUserDefinedLabels"), m_showUserDefinedLabels->GetValue());
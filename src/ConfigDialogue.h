@@ -174,6 +174,8 @@ protected:
   wxCheckBox* m_saveSize;
   wxCheckBox* m_abortOnError;
   wxCheckBox* m_pollStdOut;
+  //! Keep a second maxima process ready for restarts?
+  wxCheckBox* m_standbyMaxima;
   wxCheckBox* m_savePanes;
   wxCheckBox* m_usepngCairo;
   wxCheckBox* m_uncomressedWXMX;
@@ -202,6 +204,8 @@ protected:
   wxCheckBox* m_insertAns;
   wxSpinCtrl* m_labelWidth;
   wxSpinCtrl* m_undoLimit;
+  wxSpinCtrl* m_undoMemory;
+  wxSpinCtrl* m_treeUndoMemory;
   wxSpinCtrl* m_bitmapScale;
   wxCheckBox* m_fixReorderedIndices;
   wxCheckBox* m_showUserDefinedLabels;
@@ -66,6 +66,14 @@ void ConjugateCell::Destroy()
   m_next = NULL;
 }
 
+size_t ConjugateCell::GetMemorySize()
+{
+  return sizeof(ConjugateCell) +
+    GetListMemorySize(m_innerCell) +
+    GetListMemorySize(m_open) +
+    GetListMemorySize(m_close);
+}
+
 void ConjugateCell::SetInner(MathCell *inner)
 {
   if (inner == NULL)
@@ -28,8 +28,16 @@
 void ContentAssistantPopup::UpdateResults()
 {
   wxString partial = m_editor->GetSelectionString();
-  m_completions = m_autocomplete->CompleteSymbol(partial, m_type);
-  m_completions.Sort();
+  m_completions = m_autocomplete->CompleteSymbolFuzzy(partial, m_type);
+
+  // A single fuzzy match that doesn't start with the word that is completed
+  // is only a guess => the user has to pick it from the list.
+  if((m_completions.GetCount() == 1) && !m_completions[0].StartsWith(partial))
+  {
+    m_autocompletions->Set(m_completions);
+    m_autocompletions->SetSelection(0);
+    return;
+  }
 
   switch(m_completions.GetCount())
   {
@@ -67,7 +75,13 @@ void ContentAssistantPopup::OnKeyPress(wxKeyEvent& event)
       bool addChar = true;
       wxString word=m_editor->GetSelectionString();
       int index=word.Length();
-      do
+
+      // Fuzzy matches don't necessarily start with the word that is completed.
+      for(size_t i=0;i<m_completions.GetCount();i++)
+        if(!m_completions[i].StartsWith(word))
+          addChar = false;
+
+      while(addChar)
       {
         if(m_completions[0].Length()<=index)
           addChar = false;
@@ -85,7 +99,6 @@ void ContentAssistantPopup::OnKeyPress(wxKeyEvent& event)
           word += ch;
         }
       }
-      while(addChar);
       m_editor->ReplaceSelection(m_editor->GetSelectionString(),word,true);
     }
     break;
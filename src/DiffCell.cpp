@@ -68,6 +68,13 @@ void DiffCell::Destroy()
   m_next = NULL;
 }
 
+size_t DiffCell::GetMemorySize()
+{
+  return sizeof(DiffCell) +
+    GetListMemorySize(m_baseCell) +
+    GetListMemorySize(m_diffCell);
+}
+
 void DiffCell::SetDiff(MathCell *diff)
 {
   if (diff == NULL)
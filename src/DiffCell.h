@@ -30,6 +30,7 @@ public:
 	DiffCell();
 	~DiffCell();
   void Destroy();
+  size_t GetMemorySize();
   MathCell* Copy();
   void SetBase(MathCell *base);
   void SetDiff(MathCell *diff);
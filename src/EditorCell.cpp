@@ -22,10 +22,13 @@
 
 #include <wx/clipbrd.h>
 #include <wx/regex.h>
+#include <wx/config.h>
+#include <algorithm>
 
 #include "EditorCell.h"
 #include "wxMaxima.h"
 #include "wxMaximaFrame.h"
+#include "SearchIndex.h"
 #include <wx/tokenzr.h>
 
 #define ESC_CHAR wxT('\xA6')
@@ -33,13 +36,21 @@
 const wxString operators = wxT("+-*/^:=#'!\";$");
 
 wxString EditorCell::m_selectionString;
+long EditorCell::m_selectionStringGeneration = 0;
+wxString EditorCell::m_searchString;
+bool EditorCell::m_searchIgnoreCase = false;
+long EditorCell::m_searchStringGeneration = 0;
+size_t EditorCell::m_undoMemoryLimit = 0;
+bool EditorCell::m_undoMemoryLimitValid = false;
 
 EditorCell::EditorCell(wxString text) : MathCell()
 {
   m_selectionChanged = false;
   m_lastSelectionStart = -1;
   m_displayCaret = false;
-  m_text = wxEmptyString;
+  m_lowerCaseTextValid = false;
+  m_searchMatchGeneration = -1;
+  SetText(wxEmptyString);
   m_fontSize = -1;
   m_positionOfCaret = 0;
   m_caretColumn = -1; // used when moving up/down between lines
@@ -60,11 +71,18 @@ EditorCell::EditorCell(wxString text) : MathCell()
   m_containsChangesCheck = false;
   m_firstLineOnly = false;
   m_historyPosition = -1;
-  m_text = TabExpand(text,0);
+  m_historyBytes = 0;
+  m_historyLastTextValid = false;
+  m_styledAsCode = false;
+  m_tokenXFontSize = -1;
+  m_tokenXScale = -1;
+  m_tokenXAsterisk = false;
+  SetText(TabExpand(text,0));
 }
 
 EditorCell::~EditorCell()
 {
+  SearchIndex::Remove(this);
   if (m_next != NULL)
     delete m_next;
 }
@@ -114,10 +132,15 @@ MathCell *EditorCell::Copy()
   EditorCell *tmp = new EditorCell();
   // We cannot use SetValue() here, since SetValue() sometimes has the task to change
   //  the cell's contents
-  tmp->m_text = m_text;
+  tmp->SetText(m_text);
   tmp->m_containsChanges = m_containsChanges;
   CopyData(this, tmp);
-  tmp->m_styledText = m_styledText;
+  tmp->m_styledLines = m_styledLines;
+  tmp->m_styledAsCode = m_styledAsCode;
+  tmp->m_tokenXFontName = m_tokenXFontName;
+  tmp->m_tokenXFontSize = m_tokenXFontSize;
+  tmp->m_tokenXScale = m_tokenXScale;
+  tmp->m_tokenXAsterisk = m_tokenXAsterisk;
 
   return tmp;
 }
@@ -127,6 +150,12 @@ void EditorCell::Destroy()
   m_next = NULL;
 }
 
+size_t EditorCell::GetMemorySize()
+{
+  // The undo history of the cell is part of the cell, as well.
+  return sizeof(EditorCell) + m_text.Length() * sizeof(wxChar) + m_historyBytes;
+}
+
 wxString EditorCell::ToString()
 {
   wxString text = m_text;
@@ -299,7 +328,15 @@ void EditorCell::RecalculateWidths(CellParser& parser, int fontsize)
     double scale = parser.GetScale();
     SetFont(parser, fontsize);
 
-    dc.GetTextExtent(wxT("X"), &charWidth, &m_charHeight);
+    // The configuration might have changed the font without changing its name
+    // or size.
+    if (parser.ForceUpdate())
+      m_tokenXFontSize = -1;
+    // The text might be displayed at a different position now.
+    m_equalsSelectionGeneration = -1;
+    m_searchMatchGeneration = -1;
+
+    parser.GetTextExtent(wxT("X"), &charWidth, &m_charHeight);
 
     unsigned int newLinePos = 0, prevNewLinePos = 0;
     int width = 0, width1, height1;
@@ -315,7 +352,7 @@ void EditorCell::RecalculateWidths(CellParser& parser, int fontsize)
         newLinePos++;
       }
 
-      dc.GetTextExtent(m_text.SubString(prevNewLinePos, newLinePos), &width1, &height1);
+      parser.GetTextExtent(m_text.Mid(prevNewLinePos, newLinePos - prevNewLinePos), &width1, &height1);
       width = MAX(width, width1);
 
       while (newLinePos < m_text.Length() && m_text.GetChar(newLinePos) == '\n')
@@ -349,46 +386,50 @@ wxString EditorCell::ToHTML()
 
   while(tmp != NULL)
   {
-    std::list<StyledText> styledText = tmp->m_styledText;
-    while(!styledText.empty())
+    for(size_t line = 0; line < tmp->m_styledLines.size(); line++)
     {
-      // Grab a portion of text from the list.
-      StyledText TextSnippet = styledText.front();
-      styledText.pop_front();
+      if(line > 0)
+        retval += wxT("<BR>\n");
+      const std::vector<StyledText> &tokens = tmp->m_styledLines[line].m_tokens;
+      for(size_t i = 0; i < tokens.size(); i++)
+      {
+        // Grab a portion of text from the list.
+        StyledText TextSnippet = tokens[i];
 
-      wxString text =  PrependNBSP(EscapeHTMLChars(TextSnippet.GetText()));
+        wxString text =  PrependNBSP(EscapeHTMLChars(TextSnippet.GetText()));
 /*      wxString tmp = EscapeHTMLChars(TextSnippet.GetText());
         wxString text = tmp);*/
       
-      if(TextSnippet.StyleSet())
-      {
-        switch(TextSnippet.GetStyle())
+        if(TextSnippet.StyleSet())
         {
-        case TS_CODE_COMMENT:
-          retval+=wxT("<span class=\"code_comment\">")+text+wxT("</span>");
-          break;
-        case TS_CODE_VARIABLE:
-          retval+=wxT("<span class=\"code_variable\">")+text+wxT("</span>");
-          break;
-        case TS_CODE_FUNCTION:
-          retval+=wxT("<span class=\"code_function\">")+text+wxT("</span>");
-          break;
-        case TS_CODE_NUMBER:
-          retval+=wxT("<span class=\"code_number\">")+text+wxT("</span>");
-          break;
-        case TS_CODE_STRING:
-          retval+=wxT("<span class=\"code_string\">")+text+wxT("</span>");
-          break;
-        case TS_CODE_OPERATOR:
-          retval+=wxT("<span class=\"code_operator\">")+text+wxT("</span>");
-          break;
-        case TS_CODE_ENDOFLINE:
-        default:
-          retval+=wxT("<span class=\"code_endofline\">")+text+wxT("</span>");
-          break;
-        }
-      } else
-        retval+=text;
+          switch(TextSnippet.GetStyle())
+          {
+          case TS_CODE_COMMENT:
+            retval+=wxT("<span class=\"code_comment\">")+text+wxT("</span>");
+            break;
+          case TS_CODE_VARIABLE:
+            retval+=wxT("<span class=\"code_variable\">")+text+wxT("</span>");
+            break;
+          case TS_CODE_FUNCTION:
+            retval+=wxT("<span class=\"code_function\">")+text+wxT("</span>");
+            break;
+          case TS_CODE_NUMBER:
+            retval+=wxT("<span class=\"code_number\">")+text+wxT("</span>");
+            break;
+          case TS_CODE_STRING:
+            retval+=wxT("<span class=\"code_string\">")+text+wxT("</span>");
+            break;
+          case TS_CODE_OPERATOR:
+            retval+=wxT("<span class=\"code_operator\">")+text+wxT("</span>");
+            break;
+          case TS_CODE_ENDOFLINE:
+          default:
+            retval+=wxT("<span class=\"code_endofline\">")+text+wxT("</span>");
+            break;
+          }
+        } else
+          retval+=text;
+      }
     }
     tmp = dynamic_cast<EditorCell*>(tmp->m_next);
   }
@@ -396,21 +437,20 @@ wxString EditorCell::ToHTML()
 }
 
 void EditorCell::MarkSelection(size_t start, size_t end,CellParser& parser,double scale, wxDC& dc, TextStyle style)
+{
+  std::vector<wxRect> rects;
+  GetSelectionRects(start, end, parser, scale, rects);
+  DrawMarkers(rects, parser, dc, style);
+}
+
+void EditorCell::GetSelectionRects(size_t start, size_t end, CellParser& parser, double scale,
+                                   std::vector<wxRect> &rects)
 {
   wxRect rect = GetRect(); // rectangle representing the cell
   wxPoint point, point1;
   long pos1 = start, pos2 = start;
 
-#if defined(__WXMAC__)
-  dc.SetPen(wxNullPen); // no border on rectangles
-#else
-  dc.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(style), 1, wxPENSTYLE_SOLID)) );
-// window linux, set a pen
-#endif
-  dc.SetBrush( *(wxTheBrushList->FindOrCreateBrush(parser.GetColor(style))) ); //highlight c.
-  
-  
-  while (pos1 < end) // go through selection, draw a rect for each line of selection
+  while (pos1 < end) // go through selection, a rect for each line of selection
   {
     while (pos1 < end && m_text.GetChar(pos1) != '\n')
       pos1++;
@@ -422,15 +462,33 @@ void EditorCell::MarkSelection(size_t start, size_t end,CellParser& parser,doubl
     if (pos1 != end) // we have a \n, draw selection to the right border (mac behaviour)
       selectionWidth = rect.GetRight() - point.x - SCALE_PX(2,scale);
 #endif
-    dc.DrawRectangle(point.x + SCALE_PX(2, scale), // draw the rectangle
-                     point.y + SCALE_PX(2, scale) - m_center,
-                     selectionWidth,
-                     m_charHeight);
+    rects.push_back(wxRect(point.x - m_currentPoint.x + SCALE_PX(2, scale),
+                           point.y - m_currentPoint.y + SCALE_PX(2, scale) - m_center,
+                           selectionWidth,
+                           m_charHeight));
     pos1++;
     pos2 = pos1;
   }
 }
 
+void EditorCell::DrawMarkers(const std::vector<wxRect> &rects, CellParser& parser, wxDC& dc, TextStyle style)
+{
+  if (rects.empty())
+    return;
+
+#if defined(__WXMAC__)
+  dc.SetPen(wxNullPen); // no border on rectangles
+#else
+  dc.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(style), 1, wxPENSTYLE_SOLID)) );
+// window linux, set a pen
+#endif
+  dc.SetBrush( *(wxTheBrushList->FindOrCreateBrush(parser.GetColor(style))) ); //highlight c.
+
+  for (size_t i = 0; i < rects.size(); i++)
+    dc.DrawRectangle(m_currentPoint.x + rects[i].x, m_currentPoint.y + rects[i].y,
+                     rects[i].width, rects[i].height);
+}
+
 /* Draws the editor cell including selection and cursor
 
 The order this cell is drawn is:
@@ -466,13 +524,49 @@ void EditorCell::Draw(CellParser& parser, wxPoint point1, int fontsize)
     //
     if (m_selectionString != wxEmptyString)
     {
-      size_t start = 0;
-      while((start = m_text.find(m_selectionString,start)) != wxNOT_FOUND)
+      // The occurrences are only searched for once per selection and text.
+      if (m_equalsSelectionGeneration != m_selectionStringGeneration)
+      {
+        m_equalsSelectionRects.clear();
+        size_t start = 0;
+        while((start = m_text.find(m_selectionString,start)) != wxNOT_FOUND)
+        {
+          size_t end = start + m_selectionString.Length();
+          GetSelectionRects(start,end,parser,scale,m_equalsSelectionRects);
+          start = end;
+        }
+        m_equalsSelectionGeneration = m_selectionStringGeneration;
+      }
+      DrawMarkers(m_equalsSelectionRects,parser,dc,TS_EQUALSSELECTION);
+    }
+
+    //
+    // Mark the matches of the find dialogue
+    //
+    if (m_searchString != wxEmptyString)
+    {
+      if (m_searchMatchGeneration != m_searchStringGeneration)
       {
-        size_t end = start + m_selectionString.Length();
-        MarkSelection(start,end,parser,scale,dc,TS_EQUALSSELECTION);
-        start = end;
+        m_searchMatchRects.clear();
+        // Most cells don't contain the string: The index tells without
+        // scanning their text.
+        if (SearchIndex::MightContain(this, m_searchString))
+        {
+          wxString str = m_searchString;
+          if (m_searchIgnoreCase)
+            str.MakeLower();
+          const wxString &text = m_searchIgnoreCase ? GetLowerCaseText() : m_text;
+          size_t start = 0;
+          while((start = text.find(str,start)) != wxString::npos)
+          {
+            size_t end = start + str.Length();
+            GetSelectionRects(start,end,parser,scale,m_searchMatchRects);
+            start = end;
+          }
+        }
+        m_searchMatchGeneration = m_searchStringGeneration;
       }
+      DrawMarkers(m_searchMatchRects,parser,dc,TS_EQUALSSELECTION);
     }
     
     if (m_isActive) // draw selection or matching parens
@@ -500,12 +594,12 @@ void EditorCell::Draw(CellParser& parser, wxPoint point1, int fontsize)
 
         wxPoint point = PositionToPoint(parser, m_paren1);
         int width, height;
-        dc.GetTextExtent(m_text.GetChar(m_paren1), &width, &height);
+        parser.GetTextExtent(m_text.GetChar(m_paren1), &width, &height);
         dc.DrawRectangle(point.x + SCALE_PX(2, scale) + 1,
                          point.y  + SCALE_PX(2, scale) - m_center + 1,
                          width - 1, height - 1);
         point = PositionToPoint(parser, m_paren2);
-        dc.GetTextExtent(m_text.GetChar(m_paren1), &width, &height);
+        parser.GetTextExtent(m_text.GetChar(m_paren1), &width, &height);
         dc.DrawRectangle(point.x + SCALE_PX(2, scale) + 1,
                          point.y  + SCALE_PX(2, scale) - m_center + 1,
                          width - 1, height - 1);
@@ -523,29 +617,31 @@ void EditorCell::Draw(CellParser& parser, wxPoint point1, int fontsize)
     // TextStartingpoint.x -= SCALE_PX(MC_TEXT_PADDING, scale);
     TextStartingpoint.x += SCALE_PX(2, scale);
     TextStartingpoint.y += SCALE_PX(2, scale);
-    wxPoint TextCurrentPoint = TextStartingpoint;
-    std::list<StyledText> styledText = m_styledText;
     int lastStyle = -1;
-    while(!styledText.empty())
+
+    // Only draw the lines that intersect the region that needs to be redrawn
+    size_t firstLine = 0, lastLine = m_styledLines.size();
+    if ((parser.GetTop() != -1) && (parser.GetBottom() != -1) && (m_charHeight > 0))
     {
-      // Grab a portion of text from the list.
-      StyledText TextSnippet = styledText.front();
-      styledText.pop_front();
-      wxString TextToDraw = TextSnippet.GetText();
-      int width, height;
-      
-      // A newline is a separate token.
-      if(TextToDraw == wxT("\n"))
-      {
-        // A newline =>
-        // set the point to the beginning of the next line.
-        TextCurrentPoint.x = TextStartingpoint.x;
-        TextCurrentPoint.y += m_charHeight;
-      }
+      int top = parser.GetTop() - (TextStartingpoint.y - m_center);
+      int bottom = parser.GetBottom() - (TextStartingpoint.y - m_center);
+      if (top > 0)
+        firstLine = top / m_charHeight;
+      if (bottom < 0)
+        lastLine = 0;
       else
+        lastLine = MIN(lastLine, (size_t) (bottom / m_charHeight + 1));
+    }
+
+    for(size_t line = firstLine; line < lastLine; line++)
+    {
+      const std::vector<StyledText> &tokens = m_styledLines[line].m_tokens;
+      const std::vector<int> &tokenX = GetTokenX(parser, line);
+      for(size_t i = 0; i < tokens.size(); i++)
       {
-        // We need to draw some text.
-        
+        // Grab a portion of text from the list.
+        const StyledText &TextSnippet = tokens[i];
+
         // Grab a pen of the right color.
         if(TextSnippet.StyleSet())
         {
@@ -562,23 +658,9 @@ void EditorCell::Draw(CellParser& parser, wxPoint point1, int fontsize)
           SetForeground(parser);
         }
 
-#if defined __WXMSW__ || wxUSE_UNICODE
-        // replace "*" with centerdot if requested
-        if (parser.GetChangeAsterisk())  
-          TextToDraw.Replace(wxT("*"), wxT("\xB7"));
-#endif
-        
-        dc.DrawText(TextToDraw,
-                    TextCurrentPoint.x,
-                    TextCurrentPoint.y - m_center);
-        /*
-        dc.DrawLine(TextCurrentPoint.x + SCALE_PX(2, scale),
-                    TextCurrentPoint.y - m_center,
-                    TextCurrentPoint.x + SCALE_PX(2, scale),
-                    TextCurrentPoint.y); */
-        
-        dc.GetTextExtent(TextToDraw, &width, &height);
-        TextCurrentPoint.x += width;
+        dc.DrawText(TokenTextToDraw(parser, TextSnippet),
+                    TextStartingpoint.x + tokenX[i],
+                    TextStartingpoint.y + line * m_charHeight - m_center);
       }
     }
     //
@@ -592,7 +674,7 @@ void EditorCell::Draw(CellParser& parser, wxPoint point1, int fontsize)
 
       PositionToXY(m_positionOfCaret, &caretInColumn, &caretInLine);
 
-      int lineWidth = GetLineWidth(dc, caretInLine, caretInColumn);
+      int lineWidth = GetLineWidth(parser, caretInLine, caretInColumn);
 
       dc.SetPen(*(wxThePenList->FindOrCreatePen(parser.GetColor(TS_CURSOR), 1, wxPENSTYLE_SOLID))); //TODO is there more efficient way to do this?
 #if defined(__WXMAC__)
@@ -738,20 +820,163 @@ wxString EditorCell::TabExpand(wxString input, size_t posInLine)
   return retval;
 }
 
-size_t EditorCell::BeginningOfLine(size_t pos)
+void EditorCell::SetText(const wxString &text)
 {
-  if(pos>0)
-    pos--;
-  
-  while(pos > 0)
+  m_text = text;
+  m_lineStartsValid = false;
+  TextChanged();
+}
+
+void EditorCell::ReplaceRange(size_t start, size_t end, const wxString &text)
+{
+  // The lines that started inside the replaced range are gone, the ones that
+  // start behind it move and every newline of text starts a new line.
+  if (m_lineStartsValid)
   {
-    if(m_text[pos]==wxT('\n'))
-      break;
-    pos--;
+    std::vector<size_t>::iterator first =
+      std::upper_bound(m_lineStarts.begin(), m_lineStarts.end(), start);
+    std::vector<size_t>::iterator last =
+      std::upper_bound(first, m_lineStarts.end(), end);
+    size_t index = first - m_lineStarts.begin();
+    m_lineStarts.erase(first, last);
+
+    long shift = (long) text.Length() - (long) (end - start);
+    for (size_t i = index; i < m_lineStarts.size(); i++)
+      m_lineStarts[i] += shift;
+
+    std::vector<size_t> newLines;
+    size_t pos = start;
+    for (wxString::const_iterator it = text.begin(); it != text.end(); ++it)
+    {
+      pos++;
+      if (*it == wxT('\n'))
+        newLines.push_back(pos);
+    }
+    m_lineStarts.insert(m_lineStarts.begin() + index, newLines.begin(), newLines.end());
+  }
+
+  m_text.replace(start, end - start, text);
+  TextChanged();
+}
+
+void EditorCell::TextChanged()
+{
+  m_delimitersValid = false;
+  m_equalsSelectionGeneration = -1;
+  m_searchMatchGeneration = -1;
+  SearchIndex::TextChanged(this);
+  if (m_lowerCaseTextValid)
+  {
+    m_lowerCaseText = wxEmptyString;
+    m_lowerCaseTextValid = false;
+  }
+}
+
+void EditorCell::SetSelectionString(const wxString &text)
+{
+  if (text != m_selectionString)
+  {
+    m_selectionString = text;
+    m_selectionStringGeneration++;
+  }
+}
+
+void EditorCell::SetSearchString(const wxString &str, bool ignoreCase)
+{
+  if ((str != m_searchString) || (ignoreCase != m_searchIgnoreCase))
+  {
+    m_searchString = str;
+    m_searchIgnoreCase = ignoreCase;
+    m_searchStringGeneration++;
+  }
+}
+
+const wxString &EditorCell::GetLowerCaseText()
+{
+  if (!m_lowerCaseTextValid)
+  {
+    m_lowerCaseText = m_text.Lower();
+    m_lowerCaseTextValid = true;
   }
-  if(m_text[pos]==wxT('\n'))
-    pos++;
-  return pos;
+  return m_lowerCaseText;
+}
+
+void EditorCell::UpdateLineStarts()
+{
+  if (m_lineStartsValid)
+    return;
+
+  m_lineStarts.clear();
+  m_lineStarts.push_back(0);
+  size_t pos = 0;
+  while ((pos = m_text.find(wxT('\n'), pos)) != wxString::npos)
+    m_lineStarts.push_back(++pos);
+  m_lineStartsValid = true;
+}
+
+size_t EditorCell::LineOfPosition(size_t pos)
+{
+  UpdateLineStarts();
+  return std::upper_bound(m_lineStarts.begin(), m_lineStarts.end(), pos) -
+    m_lineStarts.begin() - 1;
+}
+
+void EditorCell::UpdateDelimiters()
+{
+  if (m_delimitersValid)
+    return;
+
+  m_quotes.clear();
+  m_parens.clear();
+  m_parenPartners.clear();
+
+  // The positions of the parenthesis of each kind that haven't been closed yet
+  std::vector<size_t> open[3];
+  static const wxString opening = wxT("([{");
+  static const wxString closing = wxT(")]}");
+
+  wxChar lastChar = wxT('\0');
+  size_t pos = 0;
+  for (wxString::const_iterator it = m_text.begin(); it != m_text.end(); ++it, ++pos)
+  {
+    wxChar ch = *it;
+    if (ch == wxT('"'))
+    {
+      if (lastChar != wxT('\\'))
+        m_quotes.push_back(pos);
+    }
+    else
+    {
+      int kind = opening.Find(ch);
+      if (kind != wxNOT_FOUND)
+      {
+        open[kind].push_back(m_parens.size());
+        m_parens.push_back(pos);
+        m_parenPartners.push_back(-1);
+      }
+      else if ((kind = closing.Find(ch)) != wxNOT_FOUND)
+      {
+        m_parenPartners.push_back(-1);
+        if (!open[kind].empty())
+        {
+          size_t partner = open[kind].back();
+          open[kind].pop_back();
+          m_parenPartners[partner] = pos;
+          m_parenPartners.back() = m_parens[partner];
+        }
+        m_parens.push_back(pos);
+      }
+    }
+    lastChar = ch;
+  }
+  m_delimitersValid = true;
+}
+
+size_t EditorCell::BeginningOfLine(size_t pos)
+{
+  if (pos > m_text.Length())
+    pos = m_text.Length();
+  return m_lineStarts[LineOfPosition(pos)];
 }
 
 void EditorCell::ProcessEvent(wxKeyEvent &event)
@@ -1001,8 +1226,7 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
       SaveValue();
       long start = MIN(m_selectionEnd, m_selectionStart);
       long end = MAX(m_selectionEnd, m_selectionStart);
-      m_text = m_text.SubString(0, start - 1) +
-               m_text.SubString(end, m_text.Length());
+      EraseRange(start, end);
       m_positionOfCaret = start;
       ClearSelection();
     }
@@ -1078,9 +1302,7 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
         for(int i=0;i<indentChars;i++)
           indentString += wxT(" ");
       
-      m_text = m_text.SubString(0, m_positionOfCaret - 1) +
-        wxT("\n") + indentString +
-        m_text.SubString(m_positionOfCaret, m_text.Length());
+      InsertAt(m_positionOfCaret, wxT("\n") + indentString);
       m_positionOfCaret++;
       if(indentChars > 0)
         m_positionOfCaret += indentChars;
@@ -1097,8 +1319,7 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
       {
         m_isDirty = true;
         m_containsChanges = true;
-        m_text = m_text.SubString(0, m_positionOfCaret - 1) +
-                 m_text.SubString(m_positionOfCaret + 1, m_text.Length());
+        EraseRange(m_positionOfCaret, m_positionOfCaret + 1);
       }
     }
     else
@@ -1109,8 +1330,7 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
       m_saveValue = true;
       long start = MIN(m_selectionEnd, m_selectionStart);
       long end = MAX(m_selectionEnd, m_selectionStart);
-      m_text = m_text.SubString(0, start - 1) +
-               m_text.SubString(end, m_text.Length());
+      EraseRange(start, end);
       m_positionOfCaret = start;
       ClearSelection();
     }
@@ -1125,8 +1345,7 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
       m_isDirty = true;
       long start = MIN(m_selectionEnd, m_selectionStart);
       long end = MAX(m_selectionEnd, m_selectionStart);
-      m_text = m_text.SubString(0, start - 1) +
-               m_text.SubString(end, m_text.Length());
+      EraseRange(start, end);
       m_positionOfCaret = start;
       ClearSelection();
       break;
@@ -1141,10 +1360,10 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
           m_containsChanges = true;
           m_isDirty = true;
           
-          if(m_text.SubString(0, m_positionOfCaret - 1).Right(4) == wxT("    ")) 
+          if((m_positionOfCaret >= 4) &&
+             (m_text.Mid(m_positionOfCaret - 4, 4) == wxT("    ")))
           {
-            m_text = m_text.SubString(0, m_positionOfCaret - 5) +
-              m_text.SubString(m_positionOfCaret, m_text.Length());
+            EraseRange(m_positionOfCaret - 4, m_positionOfCaret);
             m_positionOfCaret -= 4;
           }
           else
@@ -1157,8 +1376,7 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
                  (m_text.GetChar(m_positionOfCaret-1) == '{' && m_text.GetChar(m_positionOfCaret) == '}') ||
                  (m_text.GetChar(m_positionOfCaret-1) == '"' && m_text.GetChar(m_positionOfCaret) == '"')))
               right++;
-            m_text = m_text.SubString(0, m_positionOfCaret - 2) +
-              m_text.SubString(right, m_text.Length());
+            EraseRange(m_positionOfCaret - 1, right);
             m_positionOfCaret--;
           }
         }
@@ -1174,26 +1392,23 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
         
         int lastpos = m_positionOfCaret;
         // Delete characters until the end of the current word or number 
-        while((wxIsalnum(m_text[m_positionOfCaret - 1]))&&(m_positionOfCaret>0))
+        while((m_positionOfCaret>0)&&(wxIsalnum(m_text[m_positionOfCaret - 1])))
         {
           m_positionOfCaret--;
-          m_text = m_text.SubString(0, m_positionOfCaret - 1) +
-                   m_text.SubString(m_positionOfCaret + 1, m_text.Length());
+          EraseRange(m_positionOfCaret, m_positionOfCaret + 1);
         }            
         // Delete Spaces, Tabs and Newlines until the next printable character
-        while((wxIsspace(m_text[m_positionOfCaret - 1]))&&(m_positionOfCaret>0))
+        while((m_positionOfCaret>0)&&(wxIsspace(m_text[m_positionOfCaret - 1])))
         {
           m_positionOfCaret--;
-          m_text = m_text.SubString(0, m_positionOfCaret - 1) +
-                   m_text.SubString(m_positionOfCaret + 1, m_text.Length());
+          EraseRange(m_positionOfCaret, m_positionOfCaret + 1);
         }
         
         // If we didn't delete anything till now delete one single character.
-        if(lastpos == m_positionOfCaret)
+        if((lastpos == m_positionOfCaret) && (m_positionOfCaret > 0))
         {
           m_positionOfCaret--;
-          m_text = m_text.SubString(0, m_positionOfCaret - 1) +
-                   m_text.SubString(m_positionOfCaret + 1, m_text.Length());
+          EraseRange(m_positionOfCaret, m_positionOfCaret + 1);
         }
       }
     }
@@ -1233,18 +1448,13 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
                 for(size_t i=0;i<4;i++)
                   if(m_text[pos]==wxT(' '))
                   {
-                    m_text =
-                      m_text.SubString(0, pos - 1) +
-                      m_text.SubString(pos + 1, m_text.Length());
+                    EraseRange(pos, pos + 1);
                     end--;
                   }
               }
               else
               {
-                m_text =
-                  m_text.SubString(0, pos - 1) +
-                  wxT("    ") +
-                  m_text.SubString(pos, m_text.Length());
+                InsertAt(pos, wxT("    "));
                 end += 4;
                 pos += 4;
               }
@@ -1257,8 +1467,7 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
           }
           else
           {
-            m_text = m_text.SubString(0, start - 1) +
-              m_text.SubString(end, m_text.Length());
+            EraseRange(start, end);
             ClearSelection();
           }
           m_positionOfCaret = start;
@@ -1272,9 +1481,7 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
           ins += wxT(" ");
         } while (col%4 != 0);
 
-        m_text = m_text.SubString(0, m_positionOfCaret - 1) +
-                 ins +
-                 m_text.SubString(m_positionOfCaret, m_text.Length());
+        InsertAt(m_positionOfCaret, ins);
         m_positionOfCaret += ins.Length();
       }
     }
@@ -1282,11 +1489,11 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
 /*
   case WXK_SPACE:
     if (event.ShiftDown())
-      m_text = m_text.SubString(0, m_positionOfCaret - 1) + wxT("*") + // wxT("\x00B7")
-               m_text.SubString(m_positionOfCaret, m_text.Length());
+      SetText(m_text.SubString(0, m_positionOfCaret - 1) + wxT("*") + // wxT("\x00B7")
+              m_text.SubString(m_positionOfCaret, m_text.Length()));
     else
-      m_text = m_text.SubString(0, m_positionOfCaret - 1) + wxT(" ") +
-               m_text.SubString(m_positionOfCaret, m_text.Length());
+      SetText(m_text.SubString(0, m_positionOfCaret - 1) + wxT(" ") +
+              m_text.SubString(m_positionOfCaret, m_text.Length()));
     m_isDirty = true;
     m_containsChanges = true;
     m_positionOfCaret++;
@@ -1303,12 +1510,17 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
     {
       // TODO: search only a few positions back for an escchar (10? and not over newlines)
       bool insertescchar = false;
-      int esccharpos = m_text.Left(m_positionOfCaret).Find(ESC_CHAR, true);
+      int esccharpos = -1;
+      if (m_positionOfCaret > 0)
+      {
+        size_t found = m_text.rfind(ESC_CHAR, m_positionOfCaret - 1);
+        if (found != wxString::npos)
+          esccharpos = found;
+      }
       if (esccharpos > -1) { // we have a match, check for insertion
         wxString greek = InterpretEscapeString(m_text.SubString(esccharpos + 1, m_positionOfCaret - 1));
         if (greek.Length() > 0 ) {
-          m_text = m_text.SubString(0, esccharpos - 1) + greek +
-                   m_text.SubString(m_positionOfCaret, m_text.Length());
+          ReplaceRange(esccharpos, m_positionOfCaret, greek);
           m_positionOfCaret = esccharpos + greek.Length();
           m_isDirty = true;
           m_containsChanges = true;
@@ -1320,8 +1532,7 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
         insertescchar = true;
 
       if (insertescchar) {
-        m_text = m_text.SubString(0, m_positionOfCaret - 1) + ESC_CHAR +
-                 m_text.SubString(m_positionOfCaret, m_text.Length());
+        InsertAt(m_positionOfCaret, wxString(ESC_CHAR));
         m_isDirty = true;
         m_containsChanges = true;
         m_positionOfCaret++;
@@ -1368,11 +1579,7 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
       }
 
     if (m_historyPosition != -1) {
-      int len = m_textHistory.GetCount() - m_historyPosition;
-      m_textHistory.RemoveAt(m_historyPosition + 1, len - 1);
-      m_startHistory.erase(m_startHistory.begin() + m_historyPosition + 1, m_startHistory.end());
-      m_endHistory.erase(m_endHistory.begin() + m_historyPosition + 1, m_endHistory.end());
-      m_positionHistory.erase(m_positionHistory.begin() + m_historyPosition + 1, m_positionHistory.end());
+      TruncateHistory(m_historyPosition + 1);
       m_historyPosition = -1;
     }
 
@@ -1386,50 +1593,42 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
       switch (keyCode)
       {
       case '(':
-        m_text = m_text.SubString(0, start - 1) +   wxT("(") +
-                 m_text.SubString(start, end - 1) + wxT(")") +
-                 m_text.SubString(end, m_text.Length());
+        InsertAt(end, wxT(")"));
+        InsertAt(start, wxT("("));
         m_positionOfCaret = start;  insertLetter = false;
         break;
       case '\"':
-        m_text = m_text.SubString(0, start - 1) +   wxT("\"") +
-                 m_text.SubString(start, end - 1) + wxT("\"") +
-                 m_text.SubString(end, m_text.Length());
+        InsertAt(end, wxT("\""));
+        InsertAt(start, wxT("\""));
         m_positionOfCaret = start;  insertLetter = false;
         break;
       case '{':
-        m_text = m_text.SubString(0, start - 1) +   wxT("{") +
-                 m_text.SubString(start, end - 1) + wxT("}") +
-                 m_text.SubString(end, m_text.Length());
+        InsertAt(end, wxT("}"));
+        InsertAt(start, wxT("{"));
         m_positionOfCaret = start;  insertLetter = false;
         break;
       case '[':
-        m_text = m_text.SubString(0, start - 1) +   wxT("[") +
-                 m_text.SubString(start, end - 1) + wxT("]") +
-                 m_text.SubString(end, m_text.Length());
+        InsertAt(end, wxT("]"));
+        InsertAt(start, wxT("["));
         m_positionOfCaret = start;  insertLetter = false;
         break;
       case ')':
-        m_text = m_text.SubString(0, start - 1) +   wxT("(") +
-                 m_text.SubString(start, end - 1) + wxT(")") +
-                 m_text.SubString(end, m_text.Length());
+        InsertAt(end, wxT(")"));
+        InsertAt(start, wxT("("));
         m_positionOfCaret = end + 2; insertLetter = false;
         break;
       case '}':
-        m_text = m_text.SubString(0, start - 1) +   wxT("{") +
-                 m_text.SubString(start, end - 1) + wxT("}") +
-                 m_text.SubString(end, m_text.Length());
+        InsertAt(end, wxT("}"));
+        InsertAt(start, wxT("{"));
         m_positionOfCaret = end + 2; insertLetter = false;
         break;
       case ']':
-        m_text = m_text.SubString(0, start - 1) +   wxT("[") +
-                 m_text.SubString(start, end - 1) + wxT("]") +
-                 m_text.SubString(end, m_text.Length());
+        InsertAt(end, wxT("]"));
+        InsertAt(start, wxT("["));
         m_positionOfCaret = end + 2; insertLetter = false;
         break;
       default: // delete selection
-        m_text = m_text.SubString(0, start - 1) +
-                 m_text.SubString(end, m_text.Length());
+        EraseRange(start, end);
         m_positionOfCaret = start;
         break;
       }
@@ -1438,13 +1637,11 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
 
 // insert letter if we didn't insert brackets around selection
   if (insertLetter) {
-      m_text = m_text.SubString(0, m_positionOfCaret - 1) +
 #if wxUSE_UNICODE
-               event.GetUnicodeKey() +
+      InsertAt(m_positionOfCaret, wxString(event.GetUnicodeKey()));
 #else
-               wxString::Format(wxT("%c"), ChangeNumpadToChar(event.GetKeyCode())) +
+      InsertAt(m_positionOfCaret, wxString::Format(wxT("%c"), ChangeNumpadToChar(event.GetKeyCode())));
 #endif
-               m_text.SubString(m_positionOfCaret, m_text.Length());
 
       m_positionOfCaret++;
       
@@ -1453,46 +1650,35 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
         switch (keyCode)
         {
         case '(':
-          m_text = m_text.SubString(0, m_positionOfCaret - 1) +
-                   wxT(")") +
-                   m_text.SubString(m_positionOfCaret, m_text.Length());
+          InsertAt(m_positionOfCaret, wxT(")"));
           break;
         case '[':
-          m_text = m_text.SubString(0, m_positionOfCaret - 1) +
-                   wxT("]") +
-                   m_text.SubString(m_positionOfCaret, m_text.Length());
+          InsertAt(m_positionOfCaret, wxT("]"));
           break;
         case '{':
-          m_text = m_text.SubString(0, m_positionOfCaret - 1) +
-                   wxT("}") +
-                   m_text.SubString(m_positionOfCaret, m_text.Length());
+          InsertAt(m_positionOfCaret, wxT("}"));
           break;
         case '"':
           if (m_positionOfCaret < m_text.Length() &&
               m_text.GetChar(m_positionOfCaret) == '"')
-            m_text = m_text.SubString(0, m_positionOfCaret - 2)+
-                      m_text.SubString(m_positionOfCaret, m_text.Length());
+            EraseRange(m_positionOfCaret - 1, m_positionOfCaret);
           else
-            m_text = m_text.SubString(0, m_positionOfCaret - 1) +
-                       wxT("\"") + m_text.SubString(m_positionOfCaret, m_text.Length());
+            InsertAt(m_positionOfCaret, wxT("\""));
           break;
         case ')': // jump over ')'
           if (m_positionOfCaret < m_text.Length() &&
               m_text.GetChar(m_positionOfCaret) == ')')
-            m_text = m_text.SubString(0, m_positionOfCaret - 2) +
-                       m_text.SubString(m_positionOfCaret, m_text.Length());
+            EraseRange(m_positionOfCaret - 1, m_positionOfCaret);
           break;
         case ']': // jump over ']'
           if (m_positionOfCaret < m_text.Length() &&
               m_text.GetChar(m_positionOfCaret) == ']')
-            m_text = m_text.SubString(0, m_positionOfCaret - 2) +
-                       m_text.SubString(m_positionOfCaret, m_text.Length());
+            EraseRange(m_positionOfCaret - 1, m_positionOfCaret);
           break;
         case '}': // jump over '}'
           if (m_positionOfCaret < m_text.Length() &&
               m_text.GetChar(m_positionOfCaret) == '}')
-            m_text = m_text.SubString(0, m_positionOfCaret - 2) +
-                       m_text.SubString(m_positionOfCaret, m_text.Length());
+            EraseRange(m_positionOfCaret - 1, m_positionOfCaret);
           break;
         case '+':
         // case '-': // this could mean negative.
@@ -1505,8 +1691,7 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
           size_t len = m_text.Length();
           if (m_insertAns && len == 1 && m_positionOfCaret == 1)
           {
-            m_text = m_text.SubString(0, m_positionOfCaret - 2) + wxT("%") +
-                     m_text.SubString(m_positionOfCaret - 1, m_text.Length());
+            InsertAt(m_positionOfCaret - 1, wxT("%"));
             m_positionOfCaret += 1;
           }
           break;
@@ -1537,52 +1722,42 @@ void EditorCell::ProcessEvent(wxKeyEvent &event)
  */
 bool EditorCell::FindMatchingQuotes()
 {
+  m_paren1 = m_paren2 = -1;
+
   int pos = m_positionOfCaret;
   if (pos < 0)
-  {
-    m_paren1 = m_paren2 = -1;
     return false;
-  }
 
-  if (pos == m_text.Length() ||
-      wxString(wxT("\"")).Find(m_text.GetChar(pos)) == -1)
+  if (pos == m_text.Length() || m_text.GetChar(pos) != wxT('"'))
   {
     pos--;
-    if (pos < 0 ||
-        wxString(wxT("\"")).Find(m_text.GetChar(pos)) == -1)
-    {
-      m_paren1 = m_paren2 = -1;
+    if (pos < 0 || m_text.GetChar(pos) != wxT('"'))
       return false;
-    }
   }
 
-  int count = 0;
-  for (int i = 0; i < (int) m_text.Length(); ++i)
+  UpdateDelimiters();
+  std::vector<size_t>::const_iterator quote =
+    std::lower_bound(m_quotes.begin(), m_quotes.end(), (size_t) pos);
+
+  // An escaped quote doesn't match anything
+  if ((quote == m_quotes.end()) || (*quote != (size_t) pos))
+    return false;
+
+  size_t index = quote - m_quotes.begin();
+  if (index & 1)
   {
-    if (m_text.GetChar(i) == '"' &&
-        ((i == 0) ||
-         (i >= 1 && m_text.GetChar(i-1) != '\\')))
-    {
-      ++count;
-      if (count&1)
-      {
-        m_paren1 = i;  // open quote here
-      }
-      else
-      {
-        m_paren2 = i;  // close quote here
-        if (m_paren1 == pos || m_paren2 == pos)
-        {
-          // found the pair of quotes under the cursor
-          return true;
-        }
-      }
-    }
+    m_paren1 = m_quotes[index - 1];
+    m_paren2 = pos;
   }
-
-  // didn't find matching quotes; do not highlight quotes
-  m_paren1 = m_paren2 = -1;
-  return false;
+  else
+  {
+    // An opening quote without a closing one isn't highlighted.
+    if (index + 1 >= m_quotes.size())
+      return false;
+    m_paren1 = pos;
+    m_paren2 = m_quotes[index + 1];
+  }
+  return true;
 }
 
 void EditorCell::FindMatchingParens()
@@ -1592,76 +1767,28 @@ void EditorCell::FindMatchingParens()
     return;
   }
 
-  m_paren2 = m_positionOfCaret;
-  if (m_paren2 < 0)
-  {
-    m_paren1 = m_paren2 = -1;
+  m_paren1 = m_paren2 = -1;
+  if (m_positionOfCaret < 0)
     return;
-  }
 
-  if (m_paren2 == m_text.Length() ||
-      wxString(wxT("([{}])")).Find(m_text.GetChar(m_paren2)) == -1)
-  {
-    m_paren2--;
-    if (m_paren2 < 0 ||
-        wxString(wxT("([{}])")).Find(m_text.GetChar(m_paren2)) == -1)
-    {
-      m_paren1 = m_paren2 = -1;
-      return ;
-    }
-  }
-
-  wxChar first = m_text.GetChar(m_paren2);
-  wxChar second;
-  int dir;
+  UpdateDelimiters();
 
-  switch (first)
+  // The parenthesis can be right of the cursor or left of it.
+  std::vector<size_t>::const_iterator paren =
+    std::lower_bound(m_parens.begin(), m_parens.end(), (size_t) m_positionOfCaret);
+  if ((paren == m_parens.end()) || (*paren != (size_t) m_positionOfCaret))
   {
-  case '(':
-    second = ')';
-    dir = 1;
-    break;
-  case '[':
-    second = ']';
-    dir = 1;
-    break;
-  case '{':
-    second = '}';
-    dir = 1;
-    break;
-  case ')':
-    second = '(';
-    dir = -1;
-    break;
-  case ']':
-    second = '[';
-    dir = -1;
-    break;
-  case '}':
-    second = '{';
-    dir = -1;
-    break;
-  default:
-    return;
+    if ((paren == m_parens.begin()) || (*(paren - 1) != (size_t) m_positionOfCaret - 1))
+      return;
+    --paren;
   }
 
-  m_paren1 = m_paren2 + dir;
-  int depth = 1;
-
-  while (m_paren1 >= 0 && m_paren1 < (int)m_text.Length())
-  {
-    if (m_text.GetChar(m_paren1) == second)
-      depth--;
-    else if (m_text.GetChar(m_paren1) == first)
-      depth++;
-
-    if (depth == 0)
-      break;
-    m_paren1 += dir;
-  }
+  int partner = m_parenPartners[paren - m_parens.begin()];
+  if (partner < 0)
+    return;
 
-  if (m_paren1 < 0 || m_paren1 >= (int)m_text.Length())
-    m_paren1 = m_paren2 = -1;
+  m_paren1 = partner;
+  m_paren2 = *paren;
 }
 
 #if wxUSE_UNICODE
@@ -1902,6 +2029,13 @@ bool EditorCell::ActivateCell()
   m_isActive = !m_isActive;
   if (m_isActive)
     SaveValue();
+  else
+  {
+    // Inactive cells only keep the most recent part of their undo history
+    LimitHistory(GetUndoMemoryLimit() / EDITORCELL_INACTIVE_UNDO_SHARE);
+    m_historyLastText = wxEmptyString;
+    m_historyLastTextValid = false;
+  }
   m_displayCaret = true;
   m_hasFocus = true;
 
@@ -1924,9 +2058,10 @@ bool EditorCell::AddEnding()
   if (m_text.Left(5) == wxT(":lisp"))
     return false;
 
-  wxString text = m_text.Trim();
+  SetText(wxString(m_text).Trim());
+  wxString text = m_text;
   if (text.Right(1) != wxT(";") && text.Right(1) != wxT("$")) {
-    m_text += wxT(";");
+    SetText(m_text + wxT(";"));
     m_paren1 = m_paren2 = m_width = -1;
     StyleText();
     return true;
@@ -1941,50 +2076,37 @@ bool EditorCell::AddEnding()
 //
 void EditorCell::PositionToXY(int position, int* x, int* y)
 {
-  int col = 0, lin = 0;
-  int pos = 0;
-
-  while (pos < position)
-  {
-    if (m_text.GetChar(pos) == '\n')
-    {
-      col = 0,
-      lin++;
-    }
-    else
-      col++;
-    pos++;
-  }
-
-  *x = col;
-  *y = lin;
+  if (position < 0)
+    position = 0;
+  if (position > (int)m_text.Length())
+    position = m_text.Length();
+
+  size_t line = LineOfPosition(position);
+  *x = position - m_lineStarts[line];
+  *y = line;
 }
 
 int EditorCell::XYToPosition(int x, int y)
 {
-  int col = 0, lin = 0, pos = 0;
+  UpdateLineStarts();
 
-  while (pos < (int)m_text.Length() && lin < y)
-  {
-    if (m_text.GetChar(pos) == '\n')
-      lin++;
-    pos++;
-  }
+  if (y < 0)
+    y = 0;
+  if (y >= (int)m_lineStarts.size())
+    return m_text.Length();
 
-  while (pos < (int)m_text.Length() && col < x)
-  {
-    if (m_text.GetChar(pos) == '\n')
-      break;
-    pos++;
-    col++;
-  }
+  // The last position in this line is the one before the newline.
+  int lineEnd = m_text.Length();
+  if (y + 1 < (int)m_lineStarts.size())
+    lineEnd = m_lineStarts[y + 1] - 1;
 
-  return pos;
+  if (x < 0)
+    x = 0;
+  return MIN((int)m_lineStarts[y] + x, lineEnd);
 }
 
 wxPoint EditorCell::PositionToPoint(CellParser& parser, int pos)
 {
-  wxDC& dc = parser.GetDC();
   SetFont(parser, m_fontSize);
 
   int x = m_currentPoint.x, y = m_currentPoint.y;
@@ -2000,7 +2122,7 @@ wxPoint EditorCell::PositionToPoint(CellParser& parser, int pos)
 
   PositionToXY(pos, &cX, &cY);
 
-  width = GetLineWidth(dc, cY, cX);
+  width = GetLineWidth(parser, cY, cX);
   
   x += width;
   y += m_charHeight * cY;
@@ -2135,12 +2257,12 @@ void EditorCell::SetSelection(int start, int end)
     m_selectionStart    = start;
     m_positionOfCaret   = m_selectionEnd = end;
     if (m_selectionStart == -1 || m_selectionEnd == -1)
-      m_selectionString = wxEmptyString;
+      SetSelectionString(wxEmptyString);
     else
-      m_selectionString = m_text.SubString(
-        MIN(m_selectionStart, m_selectionEnd),
-        MAX(m_selectionStart, m_selectionEnd) - 1
-        );
+      SetSelectionString(m_text.SubString(
+                           MIN(m_selectionStart, m_selectionEnd),
+                           MAX(m_selectionStart, m_selectionEnd) - 1
+                           ));
   }  
 }
 
@@ -2231,8 +2353,7 @@ bool EditorCell::CutToClipboard()
   m_positionOfCaret = start;
 
   // We cannot use SetValue() here, since SetValue() tends to move the cursor.
-  m_text = m_text.SubString(0, start - 1) +
-           m_text.SubString(end, m_text.Length());
+  EraseRange(start, end);
   StyleText();
 
   ClearSelection();
@@ -2283,65 +2404,90 @@ void EditorCell::PasteFromClipboard(bool primary)
     wxTheClipboard->UsePrimarySelection(false);
 }
 
-int EditorCell::GetLineWidth(wxDC& dc, int line, int pos)
+wxString EditorCell::TokenTextToDraw(CellParser& parser, const StyledText &token)
 {
-  if (pos == 0)
-    return 0;
+  wxString text = token.GetText();
+#if defined __WXMSW__ || wxUSE_UNICODE
+  // replace "*" with centerdot if requested
+  if (parser.GetChangeAsterisk())
+    text.Replace(wxT("*"), wxT("\xB7"));
+#endif
+  return text;
+}
 
-  int i = 0;
-  
-  std::list<StyledText> styledText = m_styledText;
-  
-  while(!styledText.empty() && i<line)
+const std::vector<int> &EditorCell::GetTokenX(CellParser& parser, size_t line)
+{
+  // All offsets are outdated if the font has changed since they were measured.
+  if ((m_tokenXFontSize != m_fontSize) ||
+      (m_tokenXScale != parser.GetScale()) ||
+      (m_tokenXAsterisk != parser.GetChangeAsterisk()) ||
+      (m_tokenXFontName != m_fontName))
   {
-    // Grab a portion of text from the list.
-    StyledText textSnippet = styledText.front();
-    styledText.pop_front();
-    wxString text = textSnippet.GetText();
-    if (text.Right(1) == '\n')
-      i++;
+    for (size_t i = 0; i < m_styledLines.size(); i++)
+      m_styledLines[i].m_tokenX.clear();
+    m_tokenXFontSize = m_fontSize;
+    m_tokenXScale = parser.GetScale();
+    m_tokenXAsterisk = parser.GetChangeAsterisk();
+    m_tokenXFontName = m_fontName;
   }
 
-  if (i<line)
-    return 0;
-
-  int width = 0;
-  wxString text;
-  int textWidth, textHeight;
-  pos--;
-  while (!styledText.empty() && pos>=0)
+  StyledLine &styledLine = m_styledLines[line];
+  if (styledLine.m_tokenX.empty())
   {
-    StyledText textSnippet = styledText.front();
-    styledText.pop_front();
-    text = textSnippet.GetText();
-    dc.GetTextExtent(text, &textWidth, &textHeight);
-    width += textWidth;
-    pos -= text.Length();
+    int x = 0;
+    styledLine.m_tokenX.reserve(styledLine.m_tokens.size() + 1);
+    for (size_t i = 0; i < styledLine.m_tokens.size(); i++)
+    {
+      int width, height;
+      styledLine.m_tokenX.push_back(x);
+      parser.GetTextExtent(TokenTextToDraw(parser, styledLine.m_tokens[i]), &width, &height);
+      x += width;
+    }
+    styledLine.m_tokenX.push_back(x);
   }
+  return styledLine.m_tokenX;
+}
 
-  if (pos<0) {
-    width -= textWidth;
-    dc.GetTextExtent(text.SubString(0, text.Length() + pos), &textWidth, &textHeight);
-    width += textWidth;
-  }
+int EditorCell::GetLineWidth(CellParser& parser, int line, int pos)
+{
+  if (pos == 0)
+    return 0;
 
-  return width;
+  if ((line < 0) || (line >= (int) m_styledLines.size()))
+    return 0;
+
+  const std::vector<StyledText> &tokens = m_styledLines[line].m_tokens;
+  const std::vector<int> &tokenX = GetTokenX(parser, line);
+
+  // Find the token pos lies in
+  size_t i = 0;
+  int tokenStart = 0;
+  while ((i < tokens.size()) && (tokenStart + (int) tokens[i].GetText().Length() < pos))
+    tokenStart += tokens[i++].GetText().Length();
+
+  if (i >= tokens.size())
+    return tokenX.back();
+
+  if (tokenStart + (int) tokens[i].GetText().Length() == pos)
+    return tokenX[i + 1];
+
+  // Only the part of the token that lies before pos has to be measured.
+  int width, height;
+  parser.GetTextExtent(TokenTextToDraw(parser, tokens[i]).Left(pos - tokenStart), &width, &height);
+  return tokenX[i] + width;
 }
 
 
 bool EditorCell::CanUndo()
 {
-  return m_textHistory.GetCount()>0 && m_historyPosition != 0;
+  return m_history.size()>0 && m_historyPosition != 0;
 }
 
 void EditorCell::Undo()
 {
   if (m_historyPosition == -1) {
-    m_historyPosition = m_textHistory.GetCount()-1;
-    m_textHistory.Add(m_text);
-    m_startHistory.push_back(m_selectionStart);
-    m_endHistory.push_back(m_selectionEnd);
-    m_positionHistory.push_back(m_positionOfCaret);
+    m_historyPosition = m_history.size()-1;
+    AddHistoryEntry();
   }
   else
     m_historyPosition--;
@@ -2350,11 +2496,12 @@ void EditorCell::Undo()
     return ;
 
   // We cannot use SetValue() here, since SetValue() tends to move the cursor.
-  m_text = m_textHistory.Item(m_historyPosition);
+  SetText(GetHistoryText(m_historyPosition));
   StyleText();
   
-  m_positionOfCaret = m_positionHistory[m_historyPosition];
-  SetSelection(m_startHistory[m_historyPosition],m_endHistory[m_historyPosition]);
+  m_positionOfCaret = m_history[m_historyPosition].m_positionOfCaret;
+  SetSelection(m_history[m_historyPosition].m_selectionStart,
+               m_history[m_historyPosition].m_selectionEnd);
 
   m_paren1 = m_paren2 = -1;
   m_isDirty = true;
@@ -2364,9 +2511,9 @@ void EditorCell::Undo()
 
 bool EditorCell::CanRedo()
 {
-  return m_textHistory.GetCount()>0 &&
+  return m_history.size()>0 &&
     m_historyPosition >= 0 &&
-    m_historyPosition < m_textHistory.GetCount()-1;
+    m_historyPosition < (ptrdiff_t) m_history.size()-1;
 }
 
 void EditorCell::Redo()
@@ -2376,15 +2523,16 @@ void EditorCell::Redo()
 
   m_historyPosition++;
 
-  if (m_historyPosition >= m_textHistory.GetCount())
+  if (m_historyPosition >= (ptrdiff_t) m_history.size())
     return ;
 
   // We cannot use SetValue() here, since SetValue() tends to move the cursor.
-  m_text = m_textHistory.Item(m_historyPosition);
+  SetText(GetHistoryText(m_historyPosition));
   StyleText();
   
-  m_positionOfCaret = m_positionHistory[m_historyPosition];
-  SetSelection(m_startHistory[m_historyPosition],m_endHistory[m_historyPosition]);
+  m_positionOfCaret = m_history[m_historyPosition].m_positionOfCaret;
+  SetSelection(m_history[m_historyPosition].m_selectionStart,
+               m_history[m_historyPosition].m_selectionEnd);
 
   m_paren1 = m_paren2 = -1;
   m_isDirty = true;
@@ -2394,35 +2542,186 @@ void EditorCell::Redo()
 
 void EditorCell::SaveValue()
 {
-  if (m_textHistory.GetCount()>0) {
-    if (m_textHistory.Last() == m_text)
+  if (m_history.size()>0) {
+    if (GetLastHistoryText() == m_text)
       return ;
   }
 
-  if (m_historyPosition != -1) {
-    int len = m_textHistory.GetCount() - m_historyPosition;
-    m_textHistory.RemoveAt(m_historyPosition, len);
-    m_startHistory.erase(m_startHistory.begin() + m_historyPosition, m_startHistory.end());
-    m_endHistory.erase(m_endHistory.begin() + m_historyPosition, m_endHistory.end());
-    m_positionHistory.erase(m_positionHistory.begin() + m_historyPosition, m_positionHistory.end());
-  }
+  if (m_historyPosition != -1)
+    TruncateHistory(m_historyPosition);
 
-  m_textHistory.Add(m_text);
-  m_startHistory.push_back(m_selectionStart);
-  m_endHistory.push_back(m_selectionEnd);
-  m_positionHistory.push_back(m_positionOfCaret);
+  AddHistoryEntry();
   m_historyPosition = -1;
+  LimitHistory(GetUndoMemoryLimit());
 }
 
 void EditorCell::ClearUndo()
 {
-  m_textHistory.Clear();
-  m_startHistory.clear();
-  m_endHistory.clear();
-  m_positionHistory.clear();
+  m_history.clear();
+  m_historyBytes = 0;
+  m_historyLastText = wxEmptyString;
+  m_historyLastTextValid = false;
   m_historyPosition = -1;
 }
 
+size_t EditorCell::GetUndoMemoryLimit()
+{
+  if (!m_undoMemoryLimitValid)
+  {
+    int undoMemory = EDITORCELL_UNDO_MEMORY_DEFAULT;
+    wxConfig::Get()->Read(wxT("undoMemory"), &undoMemory);
+    if (undoMemory < 0)
+      undoMemory = 0;
+    m_undoMemoryLimit = ((size_t) undoMemory) * 1024;
+    m_undoMemoryLimitValid = true;
+  }
+  return m_undoMemoryLimit;
+}
+
+size_t EditorCell::HistoryEntrySize(const HistoryEntry &entry)
+{
+  return sizeof(HistoryEntry) + entry.m_text.Length() * sizeof(wxChar);
+}
+
+wxString EditorCell::GetHistoryText(size_t entry)
+{
+  // Start with the last complete copy of the text and apply all changes that
+  // follow it. The first entry always is a complete copy.
+  size_t checkpoint = entry;
+  while ((checkpoint > 0) && (!m_history[checkpoint].m_isCheckpoint))
+    checkpoint--;
+
+  wxString text = m_history[checkpoint].m_text;
+  for (size_t i = checkpoint + 1; i <= entry; i++)
+    text.replace(m_history[i].m_start, m_history[i].m_removed, m_history[i].m_text);
+  return text;
+}
+
+const wxString &EditorCell::GetLastHistoryText()
+{
+  if (!m_historyLastTextValid)
+  {
+    if (m_history.empty())
+      m_historyLastText = wxEmptyString;
+    else
+      m_historyLastText = GetHistoryText(m_history.size() - 1);
+    m_historyLastTextValid = true;
+  }
+  return m_historyLastText;
+}
+
+void EditorCell::AddHistoryEntry()
+{
+  HistoryEntry entry;
+  entry.m_length = m_text.Length();
+  entry.m_positionOfCaret = m_positionOfCaret;
+  entry.m_selectionStart = m_selectionStart;
+  entry.m_selectionEnd = m_selectionEnd;
+  entry.m_isCheckpoint = true;
+
+  if (!m_history.empty())
+  {
+    // How many changes have to be applied to the last complete copy of the
+    // text in order to restore the previous step?
+    size_t changes = 0, changedChars = 0;
+    for (size_t i = m_history.size(); (i > 0) && (!m_history[i - 1].m_isCheckpoint); i--)
+    {
+      changes++;
+      changedChars += m_history[i - 1].m_text.Length();
+    }
+
+    if (changes < EDITORCELL_UNDO_CHECKPOINT_INTERVAL - 1)
+    {
+      // Only store the part of the text that differs from the previous step.
+      const wxString &last = GetLastHistoryText();
+      size_t common = MIN(last.Length(), m_text.Length());
+      size_t prefix = 0;
+      while ((prefix < common) && (last[prefix] == m_text[prefix]))
+        prefix++;
+      size_t suffix = 0;
+      while ((suffix < common - prefix) &&
+             (last[last.Length() - 1 - suffix] == m_text[m_text.Length() - 1 - suffix]))
+        suffix++;
+
+      // If the changes since the last complete copy get bigger than the text
+      // itself we store a complete copy instead.
+      size_t inserted = m_text.Length() - prefix - suffix;
+      if (changedChars + inserted < m_text.Length())
+      {
+        entry.m_isCheckpoint = false;
+        entry.m_start = prefix;
+        entry.m_removed = last.Length() - prefix - suffix;
+        entry.m_text = m_text.Mid(prefix, inserted);
+      }
+    }
+  }
+
+  if (entry.m_isCheckpoint)
+  {
+    entry.m_start = entry.m_removed = 0;
+    entry.m_text = m_text;
+  }
+
+  m_historyBytes += HistoryEntrySize(entry);
+  m_history.push_back(entry);
+  m_historyLastText = m_text;
+  m_historyLastTextValid = true;
+}
+
+void EditorCell::TruncateHistory(size_t entries)
+{
+  if (m_history.size() <= entries)
+    return;
+
+  while (m_history.size() > entries)
+  {
+    m_historyBytes -= HistoryEntrySize(m_history.back());
+    m_history.pop_back();
+  }
+  m_historyLastText = wxEmptyString;
+  m_historyLastTextValid = false;
+}
+
+void EditorCell::LimitHistory(size_t limit)
+{
+  if ((limit == 0) || (m_historyBytes <= limit) || (m_history.size() < 2))
+    return;
+
+  // Find the oldest step we can keep if we convert it into a complete copy of
+  // its text.
+  size_t first = m_history.size() - 1;
+  size_t newerBytes = 0;
+  for (size_t i = m_history.size() - 1; i > 0; i--)
+  {
+    if (newerBytes + sizeof(HistoryEntry) + m_history[i].m_length * sizeof(wxChar) <= limit)
+      first = i;
+    newerBytes += HistoryEntrySize(m_history[i]);
+    if (newerBytes > limit)
+      break;
+  }
+
+  // The step undo currently is at has to be kept.
+  if ((m_historyPosition >= 0) && (first > (size_t) m_historyPosition))
+    first = m_historyPosition;
+  if (first == 0)
+    return;
+
+  if (!m_history[first].m_isCheckpoint)
+  {
+    wxString text = GetHistoryText(first);
+    m_history[first].m_isCheckpoint = true;
+    m_history[first].m_start = m_history[first].m_removed = 0;
+    m_history[first].m_text = text;
+  }
+  m_history.erase(m_history.begin(), m_history.begin() + first);
+  if (m_historyPosition >= 0)
+    m_historyPosition -= first;
+
+  m_historyBytes = 0;
+  for (size_t i = 0; i < m_history.size(); i++)
+    m_historyBytes += HistoryEntrySize(m_history[i]);
+}
+
 bool EditorCell::IsAlpha(wxChar ch)
 {
   static const wxString alphas = wxT("\\_%");
@@ -2565,193 +2864,254 @@ wxArrayString EditorCell::StringToTokens(wxString string)
   return retval;
 }
 
-void EditorCell::StyleText()
+void EditorCell::StyleLine(const wxString &line, const LexerState &startState,
+                           wxChar nextCharAfterLine, StyledLine &result)
 {
-  m_styledText.clear();
+  result.m_text = line;
+  result.m_startState = startState;
+  result.m_nextChar = nextCharAfterLine;
+  result.m_tokens.clear();
+  result.m_tokenX.clear();
+
+  LexerState state = startState;
 
-  if(m_type == MC_TYPE_INPUT)
+  if(m_type != MC_TYPE_INPUT)
   {
-    wxString textToStyle = m_text;
+    if(line != wxEmptyString)
+      result.m_tokens.push_back(StyledText(line));
+    result.m_endState = state;
+    return;
+  }
+
+  wxArrayString tokens = StringToTokens(line);
+
+  // The next non-whitespace character following each token - or a space if
+  // there is no such char.
+  std::vector<wxChar> nextChars(tokens.GetCount());
+  wxChar nextChar = nextCharAfterLine;
+  for(size_t i = tokens.GetCount(); i > 0; i--)
+  {
+    nextChars[i-1] = nextChar;
+    wxString nextToken = tokens[i-1];
+    nextToken=nextToken.Trim(false);
+    if(nextToken!=wxT("d"))
+      nextChar=nextToken[0];
+  }
 
-    if(m_firstLineOnly)
+  for(size_t i=0;i<tokens.GetCount();i++)
+  {
+    wxString token = tokens[i];
+    token = token.Left(token.Length()-1);
+    if(token == wxEmptyString)
+      continue;
+
+    // Strings and comments can continue over several lines.
+    if(state.m_inString)
     {
-      size_t newlinepos = textToStyle.find(wxT("\n"));
-      if(newlinepos != wxNOT_FOUND)
-      {
-        textToStyle = textToStyle.Left(newlinepos) +
-          wxString::Format(wxT(" ... + %i hidden lines"), textToStyle.Freq(wxT('\n')));
-      }
+      result.m_tokens.push_back(StyledText(TS_CODE_STRING,token));
+      if(token == wxT("\""))
+        state.m_inString = false;
+      continue;
     }
-    
-    wxArrayString tokens = StringToTokens(textToStyle);
-
-    wxString lastTokenWithText;
-    for(size_t i=0;i<tokens.GetCount();i++)
+    if(state.m_inComment)
     {
-      wxString token = tokens[i];
-      token = token.Left(token.Length()-1);
-      wxChar Ch = token[0];
-
-      // Save the last non-whitespace character in lastChar -
-      // or a space if there is no such char.
-      wxChar lastChar=wxT(' ');
-      if(lastTokenWithText!=wxEmptyString)
-            lastChar=lastTokenWithText.Right(1)[0];
-      wxString tmp = token;
-      tmp=tmp.Trim();
-      if(tmp!=wxEmptyString)
-        lastTokenWithText = tmp;
-      
-      // Save the next non-whitespace character in lastChar -
-      // or a space if there is no such char.
-      wxChar nextChar=wxT(' ');
-      size_t o = i+1;
-      while(o<tokens.GetCount())
-      {
-        wxString nextToken=tokens[o];
-        nextToken=nextToken.Trim(false);
-        if(nextToken!=wxT("d"))
-        {
-          nextChar=nextToken[0];
-          break;
-        }
-        o++;
-      }
+      result.m_tokens.push_back(StyledText(TS_CODE_COMMENT,token));
+      if(token == wxT("*/"))
+        state.m_inComment = false;
+      continue;
+    }
 
-      // Handle comments
-      if(token == wxT("\""))
-      {
-        m_styledText.push_back(StyledText(TS_CODE_STRING,token));
-        if (i+1<tokens.GetCount()) {
-          i++;
-          token = tokens[i];
-          token = token.Left(token.Length()-1);
-          m_styledText.push_back(StyledText(TS_CODE_STRING,token));
-          while ((i+1 < tokens.GetCount()) && token != wxT("\"")) {
-            i++;
-            token = tokens[i];
-            token = token.Left(token.Length()-1);
-            m_styledText.push_back(StyledText(TS_CODE_STRING,token));
-          }
-        }
-        continue;
-      }
+    wxChar Ch = token[0];
+
+    // Save the last non-whitespace character in lastChar -
+    // or a space if there is no such char.
+    wxChar lastChar = state.m_lastChar;
+    wxString tmp = token;
+    tmp=tmp.Trim();
+    if(tmp!=wxEmptyString)
+      state.m_lastChar = tmp.Last();
+
+    wxChar nextChar = nextChars[i];
+
+    // Handle strings
+    if(token == wxT("\""))
+    {
+      result.m_tokens.push_back(StyledText(TS_CODE_STRING,token));
+      state.m_inString = true;
+      continue;
+    }
 
-      if((Ch==wxT('+')) ||
-         (Ch==wxT('-'))||
-         (Ch==wxT('\x2212'))
+    if((Ch==wxT('+')) ||
+       (Ch==wxT('-'))||
+       (Ch==wxT('\x2212'))
+      )
+    {
+      if(
+        (nextChar>=wxT('0')) &&
+        (nextChar<=wxT('9'))
         )
       {
+        // Our sign precedes a number.
         if(
-          (nextChar>=wxT('0')) &&
-          (nextChar<=wxT('9'))
+          (wxIsalnum(lastChar)) ||
+          (lastChar==wxT('%'))  ||
+          (lastChar==wxT(')'))  ||
+          (lastChar==wxT('}'))  ||
+          (lastChar==wxT(']'))
           )
         {
-          // Our sign precedes a number.
-          if(
-            (wxIsalnum(lastChar)) ||
-            (lastChar==wxT('%'))  ||
-            (lastChar==wxT(')'))  ||
-            (lastChar==wxT('}'))  ||
-            (lastChar==wxT(']'))
-            )
-          {
-            m_styledText.push_back(StyledText(TS_CODE_OPERATOR,token));
-          }
-          else
-          {
-            m_styledText.push_back(StyledText(TS_CODE_NUMBER,token));
-          }
+          result.m_tokens.push_back(StyledText(TS_CODE_OPERATOR,token));
         }
         else
-            m_styledText.push_back(StyledText(TS_CODE_OPERATOR,token));
-        continue;
-      }
-
-      if(token == wxT("/*"))
-      {
-        m_styledText.push_back(StyledText(TS_CODE_COMMENT,token));
-        while ((i+1 < tokens.GetCount()) && (token != wxT("*/"))) {
-          i++;
-          token = tokens[i];
-          token = token.Left(token.Length()-1);
-          m_styledText.push_back(StyledText(TS_CODE_COMMENT,token));
-        }
-        continue;
-      }
-      
-      if(operators.Find(token) != wxNOT_FOUND)
-      {
-        if((token==wxT('$'))||(token==wxT(';')))
-          m_styledText.push_back(StyledText(TS_CODE_ENDOFLINE,token));
-        else
-          m_styledText.push_back(StyledText(TS_CODE_OPERATOR,token));
-        continue;
-      }
-      if(isdigit(token[0]))
-      {
-        m_styledText.push_back(StyledText(TS_CODE_NUMBER,token));
-        continue;
-      }
-      if((IsAlpha(token[0])) || (token[0] == wxT('\\')))
-      {
-        // Sometimes we can differ between variables and functions by the context.
-        // But I assume there cannot be an algorithm that always makes
-        // the right decision here:
-        //  - Function names can be used without the parenthesis that make out
-        //    functions.
-        //  - The same name can stand for a function and a variable
-        //  - There are indexed functions
-        //  - using lambda a user can store a function in a variable
-        //  - and is U_C1(t) really meant as a function or does it represent a variable
-        //    named U_C1 that depends on t?
-        if((tokens.GetCount()>i+1))
         {
-          wxString nextToken = tokens[i+1];
-          nextToken=nextToken.Trim(false);
-
-          if (token == wxT("for")    ||
-              token == wxT("in")     ||
-              token == wxT("while")  ||
-              token == wxT("do")     ||
-              token == wxT("thru")   ||
-              token == wxT("next")   ||
-              token == wxT("step")   ||
-              token == wxT("unless") ||
-              token == wxT("from")   ||
-              token == wxT("if")     ||
-              token == wxT("else")   ||
-              token == wxT("elif")   ||
-              token == wxT("and")    ||
-              token == wxT("or")     ||
-              token == wxT("not")    ||
-              token == wxT("true")   ||
-              token == wxT("false"))
-            m_styledText.push_back(token);
-          else if(nextChar==wxT('('))
-            m_styledText.push_back(StyledText(TS_CODE_FUNCTION,token));
-          else
-            m_styledText.push_back(StyledText(TS_CODE_VARIABLE,token));
-          continue;
+          result.m_tokens.push_back(StyledText(TS_CODE_NUMBER,token));
         }
-        else
-          m_styledText.push_back(StyledText(TS_CODE_VARIABLE,token));
       }
-      m_styledText.push_back(StyledText(token));
+      else
+        result.m_tokens.push_back(StyledText(TS_CODE_OPERATOR,token));
+      continue;
     }
-  }
-  else {
-    wxString token;
-    for (size_t i = 0; i<m_text.Length(); i++) {
-      if (m_text.GetChar(i) == '\n') {
-        m_styledText.push_back(StyledText(token));
-        m_styledText.push_back(StyledText(wxT("\n")));
-        token = wxEmptyString;
-      }
+
+    // Handle comments
+    if(token == wxT("/*"))
+    {
+      result.m_tokens.push_back(StyledText(TS_CODE_COMMENT,token));
+      state.m_inComment = true;
+      continue;
+    }
+      
+    if(operators.Find(token) != wxNOT_FOUND)
+    {
+      if((token==wxT('$'))||(token==wxT(';')))
+        result.m_tokens.push_back(StyledText(TS_CODE_ENDOFLINE,token));
       else
-        token += m_text.GetChar(i);
+        result.m_tokens.push_back(StyledText(TS_CODE_OPERATOR,token));
+      continue;
     }
-    m_styledText.push_back(StyledText(token));
+    if(isdigit(token[0]))
+    {
+      result.m_tokens.push_back(StyledText(TS_CODE_NUMBER,token));
+      continue;
+    }
+    if((IsAlpha(token[0])) || (token[0] == wxT('\\')))
+    {
+      // Sometimes we can differ between variables and functions by the context.
+      // But I assume there cannot be an algorithm that always makes
+      // the right decision here:
+      //  - Function names can be used without the parenthesis that make out
+      //    functions.
+      //  - The same name can stand for a function and a variable
+      //  - There are indexed functions
+      //  - using lambda a user can store a function in a variable
+      //  - and is U_C1(t) really meant as a function or does it represent a variable
+      //    named U_C1 that depends on t?
+      if (token == wxT("for")    ||
+          token == wxT("in")     ||
+          token == wxT("while")  ||
+          token == wxT("do")     ||
+          token == wxT("thru")   ||
+          token == wxT("next")   ||
+          token == wxT("step")   ||
+          token == wxT("unless") ||
+          token == wxT("from")   ||
+          token == wxT("if")     ||
+          token == wxT("else")   ||
+          token == wxT("elif")   ||
+          token == wxT("and")    ||
+          token == wxT("or")     ||
+          token == wxT("not")    ||
+          token == wxT("true")   ||
+          token == wxT("false"))
+        result.m_tokens.push_back(StyledText(token));
+      else if(nextChar==wxT('('))
+        result.m_tokens.push_back(StyledText(TS_CODE_FUNCTION,token));
+      else
+        result.m_tokens.push_back(StyledText(TS_CODE_VARIABLE,token));
+      continue;
+    }
+    result.m_tokens.push_back(StyledText(token));
+  }
+  result.m_endState = state;
+}
+
+void EditorCell::StyleText()
+{
+  bool styleAsCode = (m_type == MC_TYPE_INPUT);
+
+  wxString textToStyle = m_text;
+  if(styleAsCode && m_firstLineOnly)
+  {
+    size_t newlinepos = textToStyle.find(wxT("\n"));
+    if(newlinepos != wxNOT_FOUND)
+    {
+      textToStyle = textToStyle.Left(newlinepos) +
+        wxString::Format(wxT(" ... + %i hidden lines"), textToStyle.Freq(wxT('\n')));
+    }
+  }
+
+  std::vector<wxString> lines;
+  wxStringTokenizer lineTokens(textToStyle, wxT("\n"), wxTOKEN_RET_EMPTY_ALL);
+  while(lineTokens.HasMoreTokens())
+    lines.push_back(lineTokens.GetNextToken());
+  if(lines.empty())
+    lines.push_back(wxEmptyString);
+
+  // The first non-whitespace character that follows each line
+  std::vector<wxChar> nextChars(lines.size());
+  wxChar nextChar = wxT(' ');
+  for(size_t i = lines.size(); i > 0; i--)
+  {
+    nextChars[i-1] = nextChar;
+    wxString line = lines[i-1];
+    line = line.Trim(false);
+    if(line != wxEmptyString)
+      nextChar = line[0];
+  }
+
+  // Lines at the beginning and the end of the text that haven't changed can
+  // reuse their styling if the syntax highlighter enters them in the same state
+  // as last time.
+  std::vector<StyledLine> oldLines;
+  oldLines.swap(m_styledLines);
+  if(styleAsCode != m_styledAsCode)
+    oldLines.clear();
+  m_styledAsCode = styleAsCode;
+
+  size_t prefix = 0;
+  while((prefix < oldLines.size()) && (prefix < lines.size()) &&
+        (oldLines[prefix].m_text == lines[prefix]))
+    prefix++;
+  size_t suffix = 0;
+  while((suffix < oldLines.size() - prefix) && (suffix < lines.size() - prefix) &&
+        (oldLines[oldLines.size() - 1 - suffix].m_text == lines[lines.size() - 1 - suffix]))
+    suffix++;
+
+  m_styledLines.resize(lines.size());
+  LexerState state;
+  for(size_t i = 0; i < lines.size(); i++)
+  {
+    StyledLine *oldLine = NULL;
+    if(i < prefix)
+      oldLine = &oldLines[i];
+    else if(i >= lines.size() - suffix)
+      oldLine = &oldLines[i + oldLines.size() - lines.size()];
+
+    if((oldLine != NULL) &&
+       (oldLine->m_startState == state) &&
+       (oldLine->m_nextChar == nextChars[i]))
+    {
+      StyledLine &line = m_styledLines[i];
+      line.m_text = lines[i];
+      line.m_startState = oldLine->m_startState;
+      line.m_nextChar = oldLine->m_nextChar;
+      line.m_endState = oldLine->m_endState;
+      line.m_tokens.swap(oldLine->m_tokens);
+      line.m_tokenX.swap(oldLine->m_tokenX);
+    }
+    else
+      StyleLine(lines[i], state, nextChars[i], m_styledLines[i]);
+
+    state = m_styledLines[i].m_endState;
   }
 }
 
@@ -2763,28 +3123,28 @@ void EditorCell::SetValue(wxString text)
     if (m_matchParens)
     {
       if (text == wxT("(")) {
-        m_text = wxT("()");
+        SetText(wxT("()"));
         m_positionOfCaret = 1;
       }
       else if (text == wxT("[")) {
-        m_text = wxT("[]");
+        SetText(wxT("[]"));
         m_positionOfCaret = 1;
       }
       else if (text == wxT("{")) {
-        m_text = wxT("{}");
+        SetText(wxT("{}"));
         m_positionOfCaret = 1;
       }
       else if (text == wxT("\"")) {
-        m_text = wxT("\"\"");
+        SetText(wxT("\"\""));
         m_positionOfCaret = 1;
       }
       else {
-        m_text = text;
+        SetText(text);
         m_positionOfCaret = m_text.Length();
       }
     }
     else {
-      m_text = text;
+      SetText(text);
       m_positionOfCaret = m_text.Length();
     }
 
@@ -2797,14 +3157,14 @@ void EditorCell::SetValue(wxString text)
           m_text == wxT("=") ||
           m_text == wxT(","))
       {
-        m_text = wxT("%") + m_text;
+        SetText(wxT("%") + m_text);
         m_positionOfCaret = m_text.Length();
       }
     }
   }
   else
   {
-    m_text = text;
+    SetText(text);
     m_positionOfCaret = m_text.Length();
   }
 
@@ -2827,13 +3187,30 @@ bool EditorCell::CheckChanges()
 
 int EditorCell::ReplaceAll(wxString oldString, wxString newString,bool IgnoreCase)
 {
+  if (oldString == wxEmptyString)
+    return 0;
+
+  // Cells that don't contain the string stay untouched.
+  if (IgnoreCase)
+    oldString.MakeLower();
+  const wxString &searchText = IgnoreCase ? GetLowerCaseText() : m_text;
+  if (searchText.find(oldString) == wxString::npos)
+    return 0;
+
   SaveValue();
-  int count = m_text.Replace(oldString, newString);
-  if (count > 0)
+  int count = 0;
+  wxString text;
+  size_t pos = 0, match;
+  while ((match = searchText.find(oldString, pos)) != wxString::npos)
   {
-    m_containsChanges = true;
-    ClearSelection();
+    text += m_text.Mid(pos, match - pos) + newString;
+    pos = match + oldString.Length();
+    count++;
   }
+  text += m_text.Mid(pos);
+  SetText(text);
+  m_containsChanges = true;
+  ClearSelection();
   StyleText();
 
   // If text is selected setting the selection again updates m_selectionString
@@ -2843,16 +3220,32 @@ int EditorCell::ReplaceAll(wxString oldString, wxString newString,bool IgnoreCas
   return count;
 }
 
+int EditorCell::CountMatches(wxString str, bool ignoreCase)
+{
+  if (str == wxEmptyString)
+    return 0;
+
+  if (ignoreCase)
+    str.MakeLower();
+  const wxString &text = ignoreCase ? GetLowerCaseText() : m_text;
+
+  int count = 0;
+  size_t pos = 0;
+  while ((pos = text.find(str, pos)) != wxString::npos)
+  {
+    pos += str.Length();
+    count++;
+  }
+  return count;
+}
+
 bool EditorCell::FindNext(wxString str, bool down, bool ignoreCase)
 {
   int start = down ? 0 : m_text.Length();
-  wxString text(m_text);
 
   if (ignoreCase)
-  {
     str.MakeLower();
-    text.MakeLower();
-  }
+  const wxString &text = ignoreCase ? GetLowerCaseText() : m_text;
 
   if (m_selectionStart >= 0)
   {
@@ -2908,9 +3301,7 @@ bool EditorCell::ReplaceSelection(wxString oldStr, wxString newStr, bool keepSel
   
   {
     // We cannot use SetValue() here, since SetValue() tends to move the cursor.
-    m_text = m_text.SubString(0, start - 1) +
-             newStr +
-             m_text.SubString(end, m_text.Length());
+    ReplaceRange(start, end, newStr);
     StyleText();
     
     m_containsChanges = true;
@@ -2947,7 +3338,7 @@ void EditorCell::ClearSelection()
   if(SelectionActive())
   {
     m_selectionChanged = true;
-    m_selectionString = wxEmptyString;
+    SetSelectionString(wxEmptyString);
     m_oldSelectionStart = m_oldSelectionEnd = m_selectionStart = m_selectionEnd = -1;
   }
 }
@@ -27,8 +27,16 @@
 
 #include <vector>
 #include <list>
+#include <deque>
 #include <wx/tokenzr.h>
 
+//! The number of undo steps that may be stored as changes to the previous step
+#define EDITORCELL_UNDO_CHECKPOINT_INTERVAL 64
+//! The undo memory per input cell in kB if nothing else is configured
+#define EDITORCELL_UNDO_MEMORY_DEFAULT 10240
+//! Inactive cells only keep 1/EDITORCELL_INACTIVE_UNDO_SHARE of the undo memory
+#define EDITORCELL_INACTIVE_UNDO_SHARE 8
+
 /*! \file
 
   This file contains the definition of the class EditorCell
@@ -45,6 +53,11 @@ class EditorCell : public MathCell
 private:
   //! Draw a box that marks the current selection
   void MarkSelection(size_t start, size_t end,CellParser& parser,double scale, wxDC& dc, TextStyle style);
+  //! Append the boxes that mark the text between start and end, relative to the cell, to rects
+  void GetSelectionRects(size_t start, size_t end, CellParser& parser, double scale,
+                         std::vector<wxRect> &rects);
+  //! Draw boxes that are given relative to the cell
+  void DrawMarkers(const std::vector<wxRect> &rects, CellParser& parser, wxDC& dc, TextStyle style);
   /*! The start of the current selection.
 
      - >0: the position of the cursors in characters from start
@@ -63,12 +76,38 @@ private:
     for highlighting selected strings.
   */
   static wxString m_selectionString;
+  //! Is increased every time m_selectionString changes
+  static long m_selectionStringGeneration;
+  //! Change m_selectionString
+  static void SetSelectionString(const wxString &text);
+  /*! The string the find dialogue searches for
+
+    All occurrences of it are highlighted in every editor cell.
+   */
+  static wxString m_searchString;
+  //! Does the find dialogue ignore the case?
+  static bool m_searchIgnoreCase;
+  //! Is increased every time m_searchString changes
+  static long m_searchStringGeneration;
+  //! The boxes that mark the occurrences of m_searchString in this cell
+  std::vector<wxRect> m_searchMatchRects;
+  //! The m_searchStringGeneration m_searchMatchRects were created for, or -1
+  long m_searchMatchGeneration;
+  //! The boxes that mark the occurrences of m_selectionString in this cell
+  std::vector<wxRect> m_equalsSelectionRects;
+  //! The m_selectionStringGeneration m_equalsSelectionRects were created for, or -1
+  long m_equalsSelectionGeneration;
   long m_oldSelectionStart;
   long m_oldSelectionEnd;
 
 public:
   //! Has the selection changed since the last draw event?
   bool m_selectionChanged;
+  /*! Highlight all occurrences of a string in all editor cells
+
+    An empty string turns the highlighting off.
+   */
+  static void SetSearchString(const wxString &str, bool ignoreCase);
   //! The constructor
   EditorCell(wxString text = wxEmptyString);
   //! The destructor
@@ -87,6 +126,7 @@ public:
   static wxString PrependNBSP(wxString input);
 
   void Destroy();
+  size_t GetMemorySize();
   MathCell* Copy();
   /*! Recalculate the widths of the current cell.
 
@@ -117,7 +157,8 @@ public:
   }
   /*! Converts m_text to a list of styled text snippets that will later be used by draw().
 
-    \todo Actually set the needed text styles.
+    Only the lines that have changed since the last call and the lines the
+    state of the syntax highlighter has changed for are styled anew.
    */
   void StyleText();
   void Reset();
@@ -165,7 +206,7 @@ public:
   }
   bool FindMatchingQuotes();
   void FindMatchingParens();
-  int GetLineWidth(wxDC& dc, int line, int end);
+  int GetLineWidth(CellParser& parser, int line, int end);
   //! true, if this cell's width has to be recalculated.
   bool IsDirty()
   {
@@ -207,6 +248,13 @@ public:
   void Redo();
   //! Save the current contents of this cell in the undo buffer.
   void SaveValue();
+  /*! The memory an undo buffer may use in bytes, 0 meaning no limit
+
+    Is read from the configuration only once: Every keystroke needs it.
+   */
+  static size_t GetUndoMemoryLimit();
+  //! Re-read the undo memory limit on its next use as the configuration has changed
+  static void ClearUndoMemoryLimitCache() { m_undoMemoryLimitValid = false; }
   wxString DivideAtCaret();
   void CommentSelection();
   void ClearUndo();
@@ -215,11 +263,10 @@ public:
   //! Set the information if this cell needs to be re-evaluated by maxima
   void ContainsChanges(bool changes) { m_containsChanges = m_containsChangesCheck = changes; }
   bool CheckChanges();
-  /*! Replaces all occurrences of a given string
-
-    TODO: Implement the IgnoreCase case.
-   */
+  //! Replaces all occurrences of a given string
   int ReplaceAll(wxString oldString, wxString newString,bool IgnoreCase);
+  //! Count the occurrences of a string
+  int CountMatches(wxString str, bool ignoreCase);
   /*! Finds the next occurrences of a string
 
     \param str The string to search for
@@ -277,6 +324,34 @@ private:
    */
   wxArrayString StringToTokens(wxString string);
 
+  //! Replace the text of this cell. All changes to m_text have to use this function or ReplaceRange().
+  void SetText(const wxString &text);
+  /*! Replace the characters from start to end (exclusive) by text
+
+    Edits m_text in place and updates m_lineStarts from the edited range
+    instead of searching the whole text for newlines again. What still costs
+    time proportional to the length of the text on every edit is moving the
+    characters behind the edit, shifting the line starts behind it and the
+    caches that are rebuilt from the whole text: The parenthesis and quotes,
+    the lower-case copy for searching, the syntax highlighting (StyleText())
+    and the search index entry.
+   */
+  void ReplaceRange(size_t start, size_t end, const wxString &text);
+  //! Insert text at pos
+  void InsertAt(size_t pos, const wxString &text) { ReplaceRange(pos, pos, text); }
+  //! Delete the characters from start to end (exclusive)
+  void EraseRange(size_t start, size_t end) { ReplaceRange(start, end, wxEmptyString); }
+  //! Invalidate everything that has been derived from the text
+  void TextChanged();
+  //! Recreate m_lineStarts if the text has changed since it was created
+  void UpdateLineStarts();
+  //! The number of the line the position pos is in
+  size_t LineOfPosition(size_t pos);
+  //! Recreate m_quotes and m_parens if the text has changed since they were created
+  void UpdateDelimiters();
+  //! The text of this cell in lower case, used for searching while ignoring the case
+  const wxString &GetLowerCaseText();
+
   bool IsAlpha(wxChar c);
   bool IsNum(wxChar c);
   bool IsAlphaNum(wxChar c);
@@ -309,23 +384,102 @@ private:
         m_styleThisText = false;
       }
     //! Returns the piece of text
-    wxString GetText()
+    wxString GetText() const
       {
         return m_text;
       }
     //! If StyleSet() is true this function returns the color of this text portion
-    TextStyle GetStyle()
+    TextStyle GetStyle() const
       {
         return m_style;
       }
     // Has a individual text style been set for this text portion?
-    bool StyleSet()
+    bool StyleSet() const
       {
         return m_styleThisText;
       }
   };
   
-  std::list<StyledText> m_styledText;
+  /*! The state of the syntax highlighter at the beginning of a line
+
+    Strings and comments can span several lines and the style of a sign depends
+    on the text that precedes it. Everything else is decided within a line.
+   */
+  class LexerState
+  {
+  public:
+    LexerState()
+      {
+        m_inString = m_inComment = false;
+        m_lastChar = wxT(' ');
+      }
+    bool operator==(const LexerState &other) const
+      {
+        return (m_inString == other.m_inString) &&
+          (m_inComment == other.m_inComment) &&
+          (m_lastChar == other.m_lastChar);
+      }
+    //! Are we inside a string?
+    bool m_inString;
+    //! Are we inside a comment?
+    bool m_inComment;
+    //! The last non-whitespace character outside strings and comments
+    wxChar m_lastChar;
+  };
+
+  //! One line of styled text and everything its styling depends on
+  class StyledLine
+  {
+  public:
+    //! The text of this line without the newline
+    wxString m_text;
+    //! The state of the syntax highlighter at the beginning of this line
+    LexerState m_startState;
+    //! The first non-whitespace character that follows this line
+    wxChar m_nextChar;
+    //! The state of the syntax highlighter at the end of this line
+    LexerState m_endState;
+    //! The styled text snippets that make up this line
+    std::vector<StyledText> m_tokens;
+    /*! The x offsets the tokens are drawn at, followed by the width of the line
+
+      Empty, if the line hasn't been measured since it has been styled.
+     */
+    std::vector<int> m_tokenX;
+  };
+
+  /*! Style one line of text
+
+    \param line The text of the line
+    \param state The state of the syntax highlighter at the start of the line
+    \param nextChar The first non-whitespace character following the line
+    \param result The line the styled text is stored in
+   */
+  void StyleLine(const wxString &line, const LexerState &state, wxChar nextChar,
+                 StyledLine &result);
+
+  //! The styled text, line by line
+  std::vector<StyledLine> m_styledLines;
+  //! Have m_styledLines been styled as maxima code?
+  bool m_styledAsCode;
+
+  //! The text of a token the way it is drawn on the screen
+  wxString TokenTextToDraw(CellParser& parser, const StyledText &token);
+  /*! The x offsets of the tokens of a line, measured on demand
+
+    The offsets are kept until the line is restyled or the font changes so
+    redrawing the cell (for example for blinking the cursor) doesn't need to
+    measure any text. The editor's font must be selected into the dc.
+   */
+  const std::vector<int> &GetTokenX(CellParser& parser, size_t line);
+  //! The font name m_tokenX of m_styledLines has been measured with
+  wxString m_tokenXFontName;
+  //! The font size m_tokenX of m_styledLines has been measured with
+  int m_tokenXFontSize;
+  //! The scale m_tokenX of m_styledLines has been measured with
+  double m_tokenXScale;
+  //! Had asterisks been replaced by dots when m_tokenX was measured?
+  bool m_tokenXAsterisk;
 
 #if wxUSE_UNICODE
   /*! Handle ESC shortcuts for special characters
@@ -337,10 +491,76 @@ private:
   wxString InterpretEscapeString(wxString txt);
 #endif
   wxString m_text;
-  wxArrayString m_textHistory;
-  std::vector<int> m_positionHistory;
-  std::vector<int> m_startHistory;
-  std::vector<int> m_endHistory;
+  /*! The positions the lines of m_text begin at
+
+    Allows to convert between positions and lines and columns by a binary
+    search instead of scanning the text.
+   */
+  std::vector<size_t> m_lineStarts;
+  //! Is m_lineStarts up to date?
+  bool m_lineStartsValid;
+  /*! The positions of all quotes that aren't escaped by a backslash
+
+    Strings cannot be nested which means that the quotes 2n and 2n+1 form a pair.
+   */
+  std::vector<size_t> m_quotes;
+  //! The positions of all parenthesis, brackets and braces, sorted by position
+  std::vector<size_t> m_parens;
+  //! The position of the parenthesis matching the one in m_parens or -1
+  std::vector<int> m_parenPartners;
+  //! Are m_quotes and m_parens up to date?
+  bool m_delimitersValid;
+  //! A lower-case copy of m_text, created on the first case-insensitive search
+  wxString m_lowerCaseText;
+  //! Is m_lowerCaseText up to date?
+  bool m_lowerCaseTextValid;
+
+  /*! One step of the undo history
+
+    Only every few steps the whole text is stored. All other steps only contain
+    the part of the text that differs from the previous step.
+   */
+  class HistoryEntry
+  {
+  public:
+    //! Does m_text contain the whole text?
+    bool m_isCheckpoint;
+    //! The position at which the text starts to differ from the previous step
+    size_t m_start;
+    //! The number of characters of the previous step that have been replaced
+    size_t m_removed;
+    //! The whole text or the text that replaces the removed characters
+    wxString m_text;
+    //! The length of the whole text
+    size_t m_length;
+    int m_positionOfCaret;
+    int m_selectionStart;
+    int m_selectionEnd;
+  };
+
+  //! The undo memory limit from the configuration, if m_undoMemoryLimitValid
+  static size_t m_undoMemoryLimit;
+  static bool m_undoMemoryLimitValid;
+  //! The memory an undo step occupies
+  static size_t HistoryEntrySize(const HistoryEntry &entry);
+  //! Reconstruct the text of an undo step
+  wxString GetHistoryText(size_t entry);
+  //! The text of the newest undo step
+  const wxString &GetLastHistoryText();
+  //! Append the current text, cursor position and selection to the undo history
+  void AddHistoryEntry();
+  //! Keep only the oldest entries undo steps
+  void TruncateHistory(size_t entries);
+  //! Drop the oldest undo steps until the history fits into limit bytes
+  void LimitHistory(size_t limit);
+
+  std::deque<HistoryEntry> m_history;
+  //! The memory the undo history occupies
+  size_t m_historyBytes;
+  //! A copy of the text of the newest undo step
+  wxString m_historyLastText;
+  //! Is m_historyLastText up to date?
+  bool m_historyLastTextValid;
   ptrdiff_t m_historyPosition;
   //! Where inside this cell is the cursor?
   int m_positionOfCaret;
@@ -81,6 +81,16 @@ void ExptCell::Destroy()
   m_next = NULL;
 }
 
+size_t ExptCell::GetMemorySize()
+{
+  return sizeof(ExptCell) +
+    GetListMemorySize(m_baseCell) +
+    GetListMemorySize(m_powCell) +
+    GetListMemorySize(m_exp) +
+    GetListMemorySize(m_open) +
+    GetListMemorySize(m_close);
+}
+
 void ExptCell::SetPower(MathCell *power)
 {
   if (power == NULL)
@@ -31,6 +31,7 @@ public:
   ~ExptCell();
   MathCell* Copy();
   void Destroy();
+  size_t GetMemorySize();
   //! Set the mantissa
   void SetBase(MathCell *base);
   //! Set the exponent
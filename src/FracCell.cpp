@@ -98,6 +98,13 @@ void FracCell::Destroy()
   delete m_divide;
 }
 
+size_t FracCell::GetMemorySize()
+{
+  return sizeof(FracCell) +
+    GetListMemorySize(m_num) +
+    GetListMemorySize(m_denom);
+}
+
 void FracCell::SetNum(MathCell *num)
 {
   if (num == NULL)
@@ -138,7 +145,7 @@ void FracCell::RecalculateWidths(CellParser& parser, int fontsize)
     dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
     		wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
     		parser.GetFontName(TS_VARIABLE)));
-    dc.GetTextExtent(wxT("/"), &m_expDivideWidth, &height);
+    parser.GetTextExtent(wxT("/"), &m_expDivideWidth, &height);
     m_width = m_num->GetFullWidth(scale) + m_denom->GetFullWidth(scale) + m_expDivideWidth;
   }
   else
@@ -152,7 +159,7 @@ void FracCell::RecalculateWidths(CellParser& parser, int fontsize)
     dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
                       wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
                       parser.GetFontName(TS_VARIABLE)));
-    dc.GetTextExtent(wxT("X"), &m_horizontalGap, &dummy);
+    parser.GetTextExtent(wxT("X"), &m_horizontalGap, &dummy);
     m_horizontalGap /= 2;
 
     m_width = MAX(m_num->GetFullWidth(scale), m_denom->GetFullWidth(scale)) + 2 * m_horizontalGap;
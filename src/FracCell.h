@@ -39,6 +39,7 @@ public:
 
   MathCell* Copy();
   void Destroy();
+  size_t GetMemorySize();
   void RecalculateSize(CellParser& parser, int fontsize);
   void RecalculateWidths(CellParser& parser, int fontsize);
   void Draw(CellParser& parser, wxPoint point, int fontsize);
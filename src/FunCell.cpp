@@ -67,6 +67,13 @@ void FunCell::Destroy()
   m_next = NULL;
 }
 
+size_t FunCell::GetMemorySize()
+{
+  return sizeof(FunCell) +
+    GetListMemorySize(m_nameCell) +
+    GetListMemorySize(m_argCell);
+}
+
 void FunCell::SetName(MathCell *name)
 {
   if (name == NULL)
@@ -123,8 +130,8 @@ wxString FunCell::ToString()
 {
   if (m_isBroken)
     return wxEmptyString;
-  if (m_altCopyText != wxEmptyString)
-    return m_altCopyText + MathCell::ListToString();
+  if (m_altCopyText != NULL)
+    return *m_altCopyText + MathCell::ListToString();
   wxString s = m_nameCell->ListToString() + m_argCell->ListToString();
   return s;
 }
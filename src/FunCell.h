@@ -31,6 +31,7 @@ public:
   ~FunCell();
   MathCell* Copy();
   void Destroy();
+  size_t GetMemorySize();
   void SetName(MathCell *base);
   void SetArg(MathCell *index);
   void RecalculateSize(CellParser& parser, int fontsize);
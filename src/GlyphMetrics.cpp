@@ -0,0 +1,172 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "GlyphMetrics.h"
+
+std::map<wxString, GlyphMetrics *> GlyphMetrics::m_cache;
+
+GlyphMetrics::GlyphMetrics(wxDC &dc)
+{
+  for (int i = 0; i < GLYPH_TABLE_SIZE; i++)
+    m_advance[i] = -1;
+
+  int width;
+  dc.GetTextExtent(wxT("X"), &width, &m_height);
+  m_advance[int('X')] = width;
+
+  // Find out once if this font kerns or has fractional advances.
+  wxString probe = wxT(GLYPH_ADDITIVITY_PROBE);
+  int probeWidth, probeHeight;
+  dc.GetTextExtent(probe, &probeWidth, &probeHeight);
+  int sum = 0;
+  for (wxString::const_iterator it = probe.begin(); it != probe.end(); ++it)
+  {
+    int ch = (*it).GetValue();
+    int advance = LookupGlyph(ch);
+    if (advance < 0)
+      advance = MeasureGlyph(dc, ch);
+    sum += advance;
+  }
+  m_additive = (sum == probeWidth);
+}
+
+bool GlyphMetrics::CanMeasure(const wxString &text) const
+{
+  if (!IsSimpleText(text))
+    return false;
+  // Single glyphs can't be kerned against anything.
+  return m_additive || (text.Length() == 1);
+}
+
+bool GlyphMetrics::IsSimpleText(const wxString &text)
+{
+  if (text.IsEmpty())
+    return false;
+
+  for (wxString::const_iterator it = text.begin(); it != text.end(); ++it)
+  {
+    int ch = (*it).GetValue();
+
+    // Control characters like tabs and newlines
+    if (ch < 0x20)
+      return false;
+    // Combining diacritical marks
+    if ((ch >= 0x0300) && (ch < 0x0370))
+      return false;
+    // Hebrew, arabic, indic scripts and everything else up to the latin and
+    // greek extensions need shaping
+    if ((ch >= 0x0590) && (ch < 0x1E00))
+      return false;
+    // Combining marks for symbols
+    if ((ch >= 0x20D0) && (ch < 0x2100))
+      return false;
+    // Punctuation, arrows, mathematical operators and technical symbols are
+    // the last characters we handle ourselves.
+    if (ch >= 0x2C00)
+      return false;
+  }
+  return true;
+}
+
+int GlyphMetrics::LookupGlyph(int ch) const
+{
+  if (ch < GLYPH_TABLE_SIZE)
+    return m_advance[ch];
+
+  std::map<int, int>::const_iterator it = m_extraAdvance.find(ch);
+  if (it == m_extraAdvance.end())
+    return -1;
+  return it->second;
+}
+
+int GlyphMetrics::MeasureGlyph(wxDC &dc, int ch)
+{
+  int width, height;
+  dc.GetTextExtent(wxString(wxUniChar(ch)), &width, &height);
+
+  if (ch < GLYPH_TABLE_SIZE)
+    m_advance[ch] = width;
+  else
+    m_extraAdvance[ch] = width;
+  return width;
+}
+
+void GlyphMetrics::GetTextExtent(wxDC &dc, const wxString &text, wxCoord *width, wxCoord *height)
+{
+  if (!CanMeasure(text))
+  {
+    dc.GetTextExtent(text, width, height);
+    return;
+  }
+
+  int totalWidth = 0;
+  for (wxString::const_iterator it = text.begin(); it != text.end(); ++it)
+  {
+    int ch = (*it).GetValue();
+    int advance = LookupGlyph(ch);
+    if (advance < 0)
+      advance = MeasureGlyph(dc, ch);
+    totalWidth += advance;
+  }
+
+  *width = totalWidth;
+  *height = m_height;
+}
+
+bool GlyphMetrics::GetTextExtent(const wxString &text, wxCoord *width, wxCoord *height) const
+{
+  if (!CanMeasure(text))
+    return false;
+
+  int totalWidth = 0;
+  for (wxString::const_iterator it = text.begin(); it != text.end(); ++it)
+  {
+    int advance = LookupGlyph((*it).GetValue());
+    if (advance < 0)
+      return false;
+    totalWidth += advance;
+  }
+
+  *width = totalWidth;
+  *height = m_height;
+  return true;
+}
+
+GlyphMetrics *GlyphMetrics::Get(wxDC &dc)
+{
+  // The same font has different metrics on the screen and on a printer.
+  wxString key = dc.GetFont().GetNativeFontInfoDesc() +
+    wxString::Format(wxT("@%i"), dc.GetPPI().y);
+
+  std::map<wxString, GlyphMetrics *>::iterator it = m_cache.find(key);
+  if (it != m_cache.end())
+    return it->second;
+
+  GlyphMetrics *metrics = new GlyphMetrics(dc);
+  m_cache[key] = metrics;
+  return metrics;
+}
+
+void GlyphMetrics::ClearCache()
+{
+  for (std::map<wxString, GlyphMetrics *>::iterator it = m_cache.begin(); it != m_cache.end(); ++it)
+    delete it->second;
+  m_cache.clear();
+}
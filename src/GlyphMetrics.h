@@ -0,0 +1,121 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+
+  Tables of glyph advances and line heights that allow measuring text without
+  asking the device context every time.
+ */
+
+#ifndef GLYPHMETRICS_H
+#define GLYPHMETRICS_H
+
+#include <wx/wx.h>
+#include <map>
+
+//! The number of characters whose widths are stored in a flat array
+#define GLYPH_TABLE_SIZE 0x400
+
+/*! A text that is used for testing if a font's glyph advances can be added up
+
+  It contains all characters that typically are kerned against each other or
+  that form ligatures.
+ */
+#define GLYPH_ADDITIVITY_PROBE "The quick brown fox jumps over the lazy dog. AVAWATAYLTToTaYoVaWaffifl 0123456789 (x+y)*[z]/{1.5}=a^2;"
+
+/*! The glyph advances and the line height of one font at one size
+
+  Asking a wxDC for the extent of a text is expensive (on GTK every call creates
+  and lays out a pango layout) and ties the layout of the worksheet to a live
+  device context. Most of the text we display consists of a small set of
+  characters, though, that are displayed with a small set of fonts. So we
+  measure each character only once per font and add up the advances afterwards.
+
+  Text that needs complex shaping (combining characters, right-to-left or indic
+  scripts, line breaks,...) cannot be measured this way and is still passed to
+  the device context.
+
+  Many fonts kern, form ligatures or have fractional advances that are rounded
+  differently for a whole string than for its single characters. For these fonts
+  the sum of the advances would drift away from what DrawText() renders. So each
+  font is checked once against the device context and for fonts that fail this
+  check only single glyphs are measured using the table.
+ */
+class GlyphMetrics
+{
+public:
+  //! Creates the table for the font that currently is selected into dc
+  GlyphMetrics(wxDC &dc);
+
+  /*! Measure a text using the table
+
+    Glyphs that haven't been measured yet are measured using dc, which must have
+    the same font selected as the one this table has been created for.
+   */
+  void GetTextExtent(wxDC &dc, const wxString &text, wxCoord *width, wxCoord *height);
+
+  /*! Measure a text without a device context
+
+    \return false, if the text contains glyphs that haven't been measured yet,
+    needs complex shaping or is longer than one glyph and the font isn't
+    additive. In this case width and height aren't touched.
+   */
+  bool GetTextExtent(const wxString &text, wxCoord *width, wxCoord *height) const;
+
+  //! The height of a line of text in this font
+  int GetHeight() const { return m_height; }
+
+  //! Can this text be measured by adding up the advances of its characters?
+  static bool IsSimpleText(const wxString &text);
+
+  //! Does adding up the advances of this font give the width DrawText() uses?
+  bool IsAdditive() const { return m_additive; }
+
+  /*! Get the table for the font that currently is selected into dc
+
+    The table is created on the first request for each combination of font, size
+    and resolution and is kept until ClearCache() is called.
+   */
+  static GlyphMetrics *Get(wxDC &dc);
+
+  //! Forget all tables, for example because the configuration has changed
+  static void ClearCache();
+
+private:
+  //! Measure a single glyph using dc
+  int MeasureGlyph(wxDC &dc, int ch);
+  //! Returns the advance of ch or -1, if ch hasn't been measured yet
+  int LookupGlyph(int ch) const;
+  //! Can this text be measured using this table?
+  bool CanMeasure(const wxString &text) const;
+  //! The height of a line of text
+  int m_height;
+  //! Does the sum of the advances match the width of a string drawn in this font?
+  bool m_additive;
+  //! The advances of the characters below GLYPH_TABLE_SIZE. -1 means: Not measured yet.
+  int m_advance[GLYPH_TABLE_SIZE];
+  //! The advances of all other characters that have been measured so far
+  std::map<int, int> m_extraAdvance;
+
+  //! The tables for all fonts, indexed by the font description and the resolution
+  static std::map<wxString, GlyphMetrics *> m_cache;
+};
+
+#endif // GLYPHMETRICS_H
@@ -32,6 +32,9 @@
 #include "Bitmap.h"
 #include "list"
 
+//! The number of lines of text an image is assumed to be high before it is laid out
+#define ESTIMATED_IMAGE_LINES 15
+
 GroupCell::GroupCell(int groupType, wxString initString) : MathCell()
 {
   m_input = NULL;
@@ -49,8 +52,9 @@ GroupCell::GroupCell(int groupType, wxString initString) : MathCell()
   m_indent = MC_GROUP_LEFT_INDENT;
   m_hide = false;
   m_working = false;
+  m_layoutPending = false;
+  m_layoutIncomplete = false;
   m_groupType = groupType;
-  m_lastInOutput = NULL;
   m_appendedCells = NULL;
 
   // set up cell depending on groupType, so we have a working cell
@@ -189,9 +193,11 @@ void GroupCell::DestroyOutput(bool destroyFirst)
   if(destroyFirst)
   {
     m_output = NULL;
-    m_lastInOutput = NULL;
+    m_outputList.Clear();
     m_appendedCells = NULL;
   }
+  else
+    m_outputList.Attach(m_output);
 }
 
 void GroupCell::ResetInputLabel()
@@ -241,6 +247,14 @@ void GroupCell::Destroy()
   m_next = NULL;
 }
 
+size_t GroupCell::GetMemorySize()
+{
+  return sizeof(GroupCell) +
+    GetListMemorySize(m_input) +
+    GetListMemorySize(m_output) +
+    GetListMemorySize(m_hiddenTree);
+}
+
 wxString GroupCell::TexEscapeOutputCell(wxString Input)
 {
   wxString retval(Input);
@@ -289,10 +303,7 @@ void GroupCell::SetOutput(MathCell *output)
   m_output = output;
   m_output->SetParent(this);
 
-  m_lastInOutput = m_output;
-
-  while (m_lastInOutput->m_next != NULL)
-    m_lastInOutput = m_lastInOutput->m_next;
+  m_outputList.Attach(m_output);
 
   //m_appendedCells = output;
 }
@@ -321,25 +332,11 @@ void GroupCell::AppendOutput(MathCell *cell)
     if (m_groupType == GC_TYPE_CODE && m_input->m_next != NULL)
       ((EditorCell *)(m_input->m_next))->ContainsChanges(false);
 
-    m_lastInOutput = m_output;
-
-    while (m_lastInOutput->m_next != NULL)
-      m_lastInOutput = m_lastInOutput->m_next;
+    m_outputList.Attach(m_output);
   }
 
-  else {
-    MathCell *tmp = m_lastInOutput;
-    if (tmp == NULL)
-      tmp = m_output;
-
-    while (tmp->m_next != NULL)
-      tmp = tmp->m_next;
-
-    tmp->AppendCell(cell);
-
-    while (m_lastInOutput->m_next != NULL)
-      m_lastInOutput = m_lastInOutput->m_next;
-  }
+  else
+    m_outputList.Append(cell);
 
   if (m_appendedCells == NULL)
     m_appendedCells = cell;
@@ -350,8 +347,75 @@ void GroupCell::Recalculate(CellParser& parser, int d_fontsize, int m_fontsize)
   m_fontSize = d_fontsize;
   m_mathFontSize = m_fontsize;
 
+  // A cell whose layout has been invalidated has to be re-measured completely.
+  bool forceUpdate = parser.ForceUpdate();
+  if (m_layoutPending)
+    parser.SetForceUpdate(true);
+  // The cells that have been measured in the last pass remember their size.
+  else if (m_layoutIncomplete)
+    ResetSize();
+
+  parser.SetLayoutIncomplete(false);
   RecalculateWidths(parser, d_fontsize);
   RecalculateSize(parser, d_fontsize);
+  m_layoutPending = false;
+  m_layoutIncomplete = parser.LayoutIncomplete();
+
+  parser.SetForceUpdate(forceUpdate);
+}
+
+void GroupCell::EstimateSize(CellParser& parser, int d_fontsize, int m_fontsize)
+{
+  m_fontSize = d_fontsize;
+  m_mathFontSize = m_fontsize;
+  m_indent = parser.GetIndent();
+
+  // A line of text is roughly 1.5 times as high as the font size.
+  double scale = parser.GetScale();
+  int lineHeight = SCALE_PX(3 * MAX(d_fontsize, m_fontsize) / 2, scale);
+
+  int lines = 1;
+  EditorCell *editor = GetEditable();
+  if (editor != NULL)
+    lines = editor->GetValue().Freq(wxT('\n')) + 1;
+  m_center = lineHeight / 2;
+
+  if ((m_output != NULL) && !m_hide)
+  {
+    MathCell *tmp = m_output;
+    while (tmp != NULL) {
+      if ((tmp->GetType() == MC_TYPE_IMAGE) || (tmp->GetType() == MC_TYPE_SLIDE))
+        lines += ESTIMATED_IMAGE_LINES;
+      else if ((tmp == m_output) || tmp->ForceBreakLineHere())
+        lines++;
+      tmp = tmp->m_next;
+    }
+  }
+
+  m_height = lines * lineHeight;
+
+  // Keep the width we already know. Otherwise estimate it from the longest
+  // line of the input so the horizontal scroll range doesn't collapse.
+  if (m_width < 0)
+  {
+    int longestLine = 0;
+    if (editor != NULL)
+    {
+      wxString value = editor->GetValue();
+      int lineLength = 0;
+      for (wxString::const_iterator it = value.begin(); it != value.end(); ++it)
+      {
+        if (*it == wxT('\n'))
+          lineLength = 0;
+        else
+          longestLine = MAX(longestLine, ++lineLength);
+      }
+    }
+    // An average character is roughly 0.6 times as wide as the font size.
+    m_width = SCALE_PX(longestLine * MAX(d_fontsize, m_fontsize) * 3 / 5, scale);
+  }
+  m_layoutPending = true;
+  ResetData();
 }
 
 void GroupCell::RecalculateWidths(CellParser& parser, int fontsize)
@@ -423,31 +487,122 @@ void GroupCell::RecalculateSize(CellParser& parser, int fontsize)
         tmp = tmp->m_next;
       }
 
-      m_outputRect.x = m_currentPoint.x;
-      m_outputRect.y = m_currentPoint.y - m_output->GetMaxCenter();
-      m_outputRect.width = 0;
-      m_outputRect.height = 0;
-      m_height = m_input->GetMaxHeight();
-      m_width = m_input->GetFullWidth(scale);
-
-      tmp = m_output;
-      while (tmp != NULL) {
-        if (tmp->BreakLineHere() || tmp == m_output) {
-          m_width = MAX(m_width, tmp->GetLineWidth(scale));
-          m_outputRect.width = MAX(m_outputRect.width, tmp->GetLineWidth(scale));
-          m_height += tmp->GetMaxHeight();
-          if (tmp->m_bigSkip)
-            m_height += MC_LINE_SKIP;
-          m_outputRect.height += tmp->GetMaxHeight() + MC_LINE_SKIP;
-        }
-        tmp = tmp->m_nextToDraw;
-      }
+      RecalculateOutputSize(scale);
     }
   }
 
   m_appendedCells = NULL;
 }
 
+void GroupCell::ScaleLayout(double factor)
+{
+  if ((m_width < 0) || (m_height < 0))
+    return;
+
+  m_width = (int)(factor * m_width + 0.5);
+  m_height = (int)(factor * m_height + 0.5);
+  m_center = (int)(factor * m_center + 0.5);
+  m_layoutPending = true;
+  ResetData();
+}
+
+void GroupCell::RecalculateOutputSize(double scale)
+{
+  m_outputRect.x = m_currentPoint.x;
+  m_outputRect.y = m_currentPoint.y - m_output->GetMaxCenter();
+  m_outputRect.width = 0;
+  m_outputRect.height = 0;
+  m_height = m_input->GetMaxHeight();
+  m_width = m_input->GetFullWidth(scale);
+
+  MathCell *tmp = m_output;
+  while (tmp != NULL) {
+    if (tmp->BreakLineHere() || tmp == m_output) {
+      m_width = MAX(m_width, tmp->GetLineWidth(scale));
+      m_outputRect.width = MAX(m_outputRect.width, tmp->GetLineWidth(scale));
+      m_height += tmp->GetMaxHeight();
+      if (tmp->m_bigSkip)
+        m_height += MC_LINE_SKIP;
+      m_outputRect.height += tmp->GetMaxHeight() + MC_LINE_SKIP;
+    }
+    tmp = tmp->m_nextToDraw;
+  }
+}
+
+void GroupCell::Reflow(CellParser& parser)
+{
+  // Cells without a valid layout will be laid out from scratch, anyway.
+  if (m_layoutPending || (m_width < 0) || (m_height < 0))
+    return;
+  if ((m_groupType == GC_TYPE_PAGEBREAK) || (m_output == NULL) || m_hide)
+    return;
+
+  int clientWidth = parser.GetClientWidth();
+
+  // Cells that have been broken up for the old width have been measured in
+  // their broken-up form, images have been scaled to the old viewport.
+  MathCell *tmp = m_output;
+  while (tmp != NULL) {
+    if (tmp->m_isBroken ||
+        (tmp->GetType() == MC_TYPE_IMAGE) || (tmp->GetType() == MC_TYPE_SLIDE))
+    {
+      if (tmp->m_isBroken)
+        tmp->Unbreak();
+      tmp->RecalculateWidths(parser, tmp->IsMath() ? m_mathFontSize : m_fontSize);
+      tmp->RecalculateSize(parser, tmp->IsMath() ? m_mathFontSize : m_fontSize);
+    }
+    tmp = tmp->m_next;
+  }
+
+  BreakUpCells(parser, m_fontSize, clientWidth);
+  BreakLines(clientWidth);
+
+  ResetData();
+  RecalculateOutputSize(parser.GetScale());
+}
+
+void GroupCell::UpdateChildPositions(CellParser& parser)
+{
+  double scale = parser.GetScale();
+  wxPoint in(m_currentPoint);
+
+  MathCell *tmp = m_input;
+  while (tmp != NULL) {
+    tmp->m_currentPoint.x = in.x;
+    tmp->m_currentPoint.y = in.y;
+    in.x += tmp->GetWidth() + SCALE_PX(MC_CELL_SKIP, scale);
+    tmp = tmp->m_nextToDraw;
+  }
+
+  if ((m_output == NULL) || m_hide)
+    return;
+
+  // The same steps as in Draw(), just without drawing anything.
+  in = m_currentPoint;
+  tmp = m_output;
+  int drop = tmp->GetMaxDrop();
+  in.y += m_input->GetMaxDrop() + m_output->GetMaxCenter();
+  m_outputRect.y = in.y - m_output->GetMaxCenter();
+  m_outputRect.x = in.x;
+
+  while (tmp != NULL) {
+    if (!tmp->m_isBroken) {
+      tmp->m_currentPoint.x = in.x;
+      tmp->m_currentPoint.y = in.y;
+      if ((tmp->m_nextToDraw != NULL) && !tmp->m_nextToDraw->BreakLineHere())
+        in.x += (tmp->GetWidth() + MC_CELL_SKIP);
+    }
+    if ((tmp->m_nextToDraw != NULL) && tmp->m_nextToDraw->BreakLineHere()) {
+      in.x = m_indent;
+      in.y += drop + tmp->m_nextToDraw->GetMaxCenter();
+      if (tmp->m_bigSkip)
+        in.y += MC_LINE_SKIP;
+      drop = tmp->m_nextToDraw->GetMaxDrop();
+    }
+    tmp = tmp->m_nextToDraw;
+  }
+}
+
 // We assume that appended cells will be in a new line!
 void GroupCell::RecalculateAppended(CellParser& parser)
 {
@@ -457,6 +612,7 @@ void GroupCell::RecalculateAppended(CellParser& parser)
   MathCell *tmp = m_appendedCells;
   int fontsize = m_fontSize;
   double scale = parser.GetScale();
+  parser.SetLayoutIncomplete(false);
 
   // Recalculate widths of cells
   while (tmp != NULL) {
@@ -489,6 +645,8 @@ void GroupCell::RecalculateAppended(CellParser& parser)
     tmp = tmp->m_nextToDraw;
   }
 
+  if (parser.LayoutIncomplete())
+    m_layoutIncomplete = true;
   m_appendedCells = NULL;
 }
 
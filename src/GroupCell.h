@@ -65,6 +65,7 @@ public:
   ~GroupCell();
   MathCell* Copy();
   void Destroy();
+  size_t GetMemorySize();
   // general methods
   int GetGroupType() { return m_groupType; }
   void SetParent(MathCell *parent); // setting parent for all mathcells in GC
@@ -111,6 +112,50 @@ public:
   void RecalculateSize(CellParser& parser, int fontsize);
   void RecalculateWidths(CellParser& parser, int fontsize);
   void Recalculate(CellParser& parser, int d_fontsize, int m_fontsize);
+  /*! Mark the layout of this cell as outdated
+
+    In contrast to ResetSize() the old size is kept and can be used as an
+    estimate until the cell is laid out again.
+   */
+  void InvalidateLayout() { m_layoutPending = true; }
+  //! Does this cell still wait for being laid out or for being laid out completely?
+  bool LayoutPending() { return m_layoutPending || m_layoutIncomplete; }
+  /*! Has this cell been laid out, but with parts of it left unmeasured?
+
+    The next Recalculate() continues measuring where the last one stopped.
+   */
+  bool LayoutIncomplete() { return m_layoutIncomplete && !m_layoutPending; }
+  /*! Guess the size of this cell without laying it out
+
+    Used for cells that are far away from the viewport: They get an estimated
+    size and are marked as pending until they are scrolled near the viewport.
+   */
+  void EstimateSize(CellParser& parser, int d_fontsize, int m_fontsize);
+  /*! Scale the size of this cell without measuring it again
+
+    Used on zooming: Until the cell is laid out at the new zoom factor its old
+    size, scaled by the change of the zoom factor, is a good estimate for the
+    positions of the cells below it and for the scrollbars. Only the size of
+    the GroupCell itself is scaled: Its contents keep the metrics of the old
+    zoom factor and the cell is marked as pending, so it isn't drawn before
+    it has been measured again.
+   */
+  void ScaleLayout(double factor);
+  /*! Adapt the layout of this cell to a new client width
+
+    Reuses the cached sizes of all cells and only re-runs the line breaking.
+    Only cells that were broken up for the old width or that have to be broken
+    up for the new one and images (that are scaled to fit the viewport) are
+    measured again.
+   */
+  void Reflow(CellParser& parser);
+  /*! Set the positions of the input cells and of the output lines
+
+    Normally Draw() sets them. A cell that has been laid out but not drawn since
+    (for example as it is outside the viewport) needs them before the caret
+    inside it can be scrolled to.
+   */
+  void UpdateChildPositions(CellParser& parser);
   void BreakUpCells(CellParser parser, int fontsize, int clientWidth);
   void BreakUpCells(MathCell *cell, CellParser parser, int fontsize, int clientWidth);
   void UnBreakUpCells();
@@ -215,14 +260,21 @@ protected:
      - true:  Destroy all output cells.
   */
   void DestroyOutput(bool destroyFirst = true);
+  //! Calculate our width and height from the sizes of the input and output lines
+  void RecalculateOutputSize(double scale);
   MathCell *m_input;
   MathCell *m_output;
   bool m_hide;
   bool m_working;
+  //! true = our size is only an estimate until the next Recalculate().
+  bool m_layoutPending;
+  //! true = a progressive layout has left parts of the output unmeasured.
+  bool m_layoutIncomplete;
   int m_indent;
   int m_fontSize;
   int m_mathFontSize;
-  MathCell *m_lastInOutput;
+  //! Allows appending to the output without searching for its end
+  CellListBuilder m_outputList;
   MathCell *m_appendedCells;
   wxRect m_outputRect;
 };
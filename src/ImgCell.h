@@ -59,6 +59,8 @@ public:
     needed.
    */
   virtual void ClearCache(){if(m_image)m_image->ClearCache();}
+  //! The size of the compressed image
+  virtual size_t GetDataSize(){if(m_image)return m_image->GetCompressedImage().GetDataLen(); else return 0;}
   //! Sets the bitmap that is shown
   void SetBitmap(const wxBitmap &bitmap);
   //! Copies the cell to the system's clipboard
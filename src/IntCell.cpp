@@ -97,6 +97,15 @@ void IntCell::Destroy()
   m_next = NULL;
 }
 
+size_t IntCell::GetMemorySize()
+{
+  return sizeof(IntCell) +
+    GetListMemorySize(m_base) +
+    GetListMemorySize(m_under) +
+    GetListMemorySize(m_over) +
+    GetListMemorySize(m_var);
+}
+
 void IntCell::SetOver(MathCell* over)
 {
   if (over == NULL)
@@ -155,7 +164,7 @@ void IntCell::RecalculateWidths(CellParser& parser, int fontsize)
     dc.SetFont( wxFont(fontsize1, wxFONTFAMILY_MODERN,
 		       wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
 		       parser.GetTeXCMEX()));
-    dc.GetTextExtent(wxT("\x5A"), &m_signWidth, &m_signSize);
+    parser.GetTextExtent(wxT("\x5A"), &m_signWidth, &m_signSize);
 
 #if defined __WXMSW__
     m_signWidth = m_signWidth / 2;
@@ -177,7 +186,7 @@ void IntCell::RecalculateWidths(CellParser& parser, int fontsize)
 		      wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL,
 		      false,
                       parser.GetSymbolFontName()));
-    dc.GetTextExtent(INTEGRAL_TOP, &m_charWidth, &m_charHeight);
+    parser.GetTextExtent(INTEGRAL_TOP, &m_charWidth, &m_charHeight);
 
     m_width = m_signWidth +
               m_base->GetFullWidth(scale) +
@@ -36,6 +36,7 @@ public:
   ~IntCell();
   MathCell* Copy();
   void Destroy();
+  size_t GetMemorySize();
   void RecalculateSize(CellParser& parser, int fontsize);
   void RecalculateWidths(CellParser& parser, int fontsize);
   void Draw(CellParser& parser, wxPoint point, int fontsize);
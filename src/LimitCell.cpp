@@ -79,6 +79,14 @@ void LimitCell::Destroy()
   m_next = NULL;
 }
 
+size_t LimitCell::GetMemorySize()
+{
+  return sizeof(LimitCell) +
+    GetListMemorySize(m_base) +
+    GetListMemorySize(m_under) +
+    GetListMemorySize(m_name);
+}
+
 void LimitCell::SetName(MathCell* name)
 {
   if (name == NULL)
@@ -30,6 +30,7 @@ public:
   LimitCell();
   ~LimitCell();
   void Destroy();
+  size_t GetMemorySize();
   MathCell* Copy();
   void RecalculateSize(CellParser& parser, int fontsize);
   void RecalculateWidths(CellParser& parser, int fontsize);
@@ -21,6 +21,12 @@
 
 #include "MathCell.h"
 
+/* Every cell of a long output carries all members of MathCell. This fails to
+   compile if a big member like an inline wxString is added again: On a 64-bit
+   build MathCell currently needs 120 bytes, with an inline wxString for the
+   alternative copy text and unpacked flags it needed 168. */
+typedef char MathCellSizeCheck[(sizeof(MathCell) <= 8 * sizeof(void *) + 16 * sizeof(int)) ? 1 : -1];
+
 MathCell::MathCell()
 {
   m_next = NULL;
@@ -46,13 +52,31 @@ MathCell::MathCell()
   m_textStyle = TS_VARIABLE;
   m_SuppressMultiplicationDot = false;
   m_imageBorderWidth = 0;
+  m_altCopyText = NULL;
 }
 
 /***
  * Derived classes must test if m_next equals NULL if it doesn't delete it!!!
  */
 MathCell::~MathCell()
-{}
+{
+  if (m_altCopyText != NULL)
+    delete m_altCopyText;
+}
+
+void MathCell::SetAltCopyText(wxString text)
+{
+  if (text == wxEmptyString)
+  {
+    if (m_altCopyText != NULL)
+      delete m_altCopyText;
+    m_altCopyText = NULL;
+  }
+  else if (m_altCopyText == NULL)
+    m_altCopyText = new wxString(text);
+  else
+    *m_altCopyText = text;
+}
 
 void MathCell::SetType(int type)
 {
@@ -163,6 +187,47 @@ void MathCell::AppendCell(MathCell *p_next)
 };
 
 
+void CellListBuilder::Attach(MathCell *first)
+{
+  m_first = m_last = first;
+  m_lastAppended = NULL;
+  if (m_last != NULL)
+    while (m_last->m_next != NULL)
+      m_last = m_last->m_next;
+}
+
+void CellListBuilder::Append(MathCell *cells)
+{
+  if (cells == NULL)
+    return;
+
+  if (m_first == NULL)
+    m_first = cells;
+  else
+  {
+    m_first->m_maxDrop = -1;
+    m_first->m_maxCenter = -1;
+
+    m_last->m_next = cells;
+    cells->m_previous = m_last;
+
+    // The last cell might have been broken up into several cells since it
+    // has been appended => we still have to search the end of the list that
+    // is sorted by the drawing order. But this search starts at the last cell
+    // of the list, not at its beginning.
+    MathCell *lastToDraw = m_last;
+    while (lastToDraw->m_nextToDraw != NULL)
+      lastToDraw = lastToDraw->m_nextToDraw;
+    lastToDraw->m_nextToDraw = cells;
+    cells->m_previousToDraw = lastToDraw;
+  }
+
+  m_lastAppended = cells;
+  m_last = cells;
+  while (m_last->m_next != NULL)
+    m_last = m_last->m_next;
+}
+
 /***
  * Get the pointer to the parent group cell
  */
@@ -603,6 +668,14 @@ void MathCell::UnbreakList()
   }
 }
 
+size_t MathCell::GetListMemorySize(MathCell *list)
+{
+  size_t size = 0;
+  for (MathCell *tmp = list; tmp != NULL; tmp = tmp->m_next)
+    size += tmp->GetMemorySize();
+  return size;
+}
+
 void MathCell::DestroyList()
 {
   MathCell *tmp, *next;
@@ -650,7 +723,8 @@ void MathCell::UnsetPen(CellParser& parser)
  */
 void MathCell::CopyData(MathCell* s, MathCell* t)
 {
-  t->m_altCopyText = s->m_altCopyText;
+  if (s->m_altCopyText != NULL)
+    t->SetAltCopyText(*s->m_altCopyText);
   t->m_forceBreakLine = s->m_forceBreakLine;
   t->m_type = s->m_type;
   t->m_textStyle = s->m_textStyle;
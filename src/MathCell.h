@@ -57,6 +57,7 @@
 #include <wx/wx.h>
 #include "CellParser.h"
 #include "TextStyle.h"
+#include "CellPool.h"
 
 /*! The supported types of math cells
  */
@@ -106,6 +107,16 @@ class MathCell
 public:
   MathCell();
   virtual ~MathCell();  
+  //! Cells are allocated from the CellPool
+  static void *operator new(size_t size)
+  {
+    return CellPool::Allocate(size);
+  }
+  //! Returns the memory of a cell to the CellPool
+  static void operator delete(void *p, size_t size)
+  {
+    CellPool::Free(p, size);
+  }
   /*! Free all memory directly referenced by the contents of this cell
 
     This command (and the celltype-specific versions of the derived
@@ -163,6 +174,20 @@ public:
    */
   virtual void ClearCache(){}
 
+  /*! The memory the data of this cell occupies that isn't part of the cell itself
+
+    Used for estimating how much memory the cells in the undo buffer occupy.
+   */
+  virtual size_t GetDataSize(){return 0;}
+  /*! The memory this cell and all cells inside it occupy
+
+    The cells that follow this one in its list aren't included.
+    Used for estimating how much memory the cells in the undo buffer occupy.
+   */
+  virtual size_t GetMemorySize(){return sizeof(MathCell) + GetDataSize();}
+  //! The memory a list of cells and all cells inside them occupy
+  static size_t GetListMemorySize(MathCell *list);
+
   /*! Clears the cache of the whole list of cells starting with this one.
 
     For details see ClearCache().
@@ -394,14 +419,23 @@ public:
        between nummerator and denominator.
   */
   wxPoint m_currentPoint;  
-  bool m_bigSkip;
+  bool m_bigSkip : 1;
   //! true means: Add a linebreak to the end of this cell.
-  bool m_isBroken;
+  bool m_isBroken : 1;
   /*! True means: This cell is a multiplication sign that isn't drawn.
 
     Currently only the centered dots for multiplications fall in this category.
    */
-  bool m_isHidden;
+  bool m_isHidden : 1;
+  /*! Do we want to begin this cell with a center dot if it is part of a product?
+
+    Maxima will represent a product like (a*b*c) by a list like the following:
+    [*,a,b,c]. This would result us in converting (a*b*c) to the following LaTeX
+    code: \left(\cdot a \cdot b \cdot c\right) which obviously is one \cdot too
+    many => we need parenthesis cells to set this flag for the first cell in 
+    their "inner cell" list.
+   */
+  bool m_SuppressMultiplicationDot : 1;
   /*! Determine if this cell contains text that won't be passed to maxima
 
     \return true, if this is a text cell, a title cell, a section, a subsection or a subsubsection cell.
@@ -449,7 +483,7 @@ public:
   void SetParentList(MathCell *parent);
   void SetStyle(int style) { m_textStyle = style; }
   bool IsMath();
-  void SetAltCopyText(wxString text) { m_altCopyText = text; }
+  void SetAltCopyText(wxString text);
   /*! Attach a copy of the list of cells that follows this one to a cell
     
     Used by MathCell::Copy() when the parameter <code>all</code> is true.
@@ -463,16 +497,6 @@ public:
     from.
   */
   virtual MathCell* Copy() = 0;
-  /*! Do we want to begin this cell with a center dot if it is part of a product?
-
-    Maxima will represent a product like (a*b*c) by a list like the following:
-    [*,a,b,c]. This would result us in converting (a*b*c) to the following LaTeX
-    code: \left(\cdot a \cdot b \cdot c\right) which obviously is one \cdot too
-    many => we need parenthesis cells to set this flag for the first cell in 
-    their "inner cell" list.
-   */
-  bool m_SuppressMultiplicationDot;
-
   /*! Set the size of the canvas our cells have to be drawn on
 
    */
@@ -508,13 +532,72 @@ protected:
   int m_textStyle;
 
   //! Does this cell begin with a forced page break?
-  bool m_breakPage;
+  bool m_breakPage : 1;
   //! Are we allowed to add a linee break before this cell?
-  bool m_breakLine;
+  bool m_breakLine : 1;
   //! true means we forcce this cell to begin with a line break.  
-  bool m_forceBreakLine;
-  bool m_highlight;
-  wxString m_altCopyText; // m_altCopyText is not check in all cells!
+  bool m_forceBreakLine : 1;
+  bool m_highlight : 1;
+  /*! The text that is copied instead of the contents of this cell
+
+    Only very few cells have one => this string is only allocated on demand
+    and reads NULL for all other cells.
+    m_altCopyText is not check in all cells!
+  */
+  wxString *m_altCopyText;
+
+  friend class CellListBuilder;
+};
+
+/*! Builds a list of cells by appending cells to its end
+
+  MathCell::AppendCell() searches the end of the list every time it is called
+  which makes building a list of n cells cell by cell O(n^2). This class instead
+  remembers the last cell of the list so appending only costs as much as walking
+  through the cells that are appended.
+
+  The builder doesn't own the cells: The list it builds is accessed by GetFirst()
+  and is deleted by whoever takes it over.
+ */
+class CellListBuilder
+{
+public:
+  CellListBuilder()
+  {
+    Clear();
+  }
+
+  //! Start a new, empty list
+  void Clear()
+  {
+    m_first = m_last = m_lastAppended = NULL;
+  }
+
+  /*! Continue an existing list
+
+    This has to walk through the whole list once in order to find its end.
+  */
+  void Attach(MathCell *first);
+
+  /*! Append a cell or a list of cells to the end of the list
+
+    Does nothing if cells is NULL.
+  */
+  void Append(MathCell *cells);
+
+  //! The first cell of the list, NULL if the list is empty
+  MathCell *GetFirst() const { return m_first; }
+
+  //! The last cell of the list, NULL if the list is empty
+  MathCell *GetLast() const { return m_last; }
+
+  //! The first cell of what has been appended last
+  MathCell *GetLastAppended() const { return m_lastAppended; }
+
+private:
+  MathCell *m_first;
+  MathCell *m_last;
+  MathCell *m_lastAppended;
 };
 
 #endif // MATHCELL_H
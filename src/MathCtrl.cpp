@@ -33,6 +33,7 @@
 #include "ImgCell.h"
 #include "MarkDown.h"
 #include "ContentAssistantPopup.h"
+#include "SearchIndex.h"
 
 #include <wx/clipbrd.h>
 #include <wx/config.h>
@@ -45,10 +46,16 @@
 #include <wx/txtstrm.h>
 #include <wx/filesys.h>
 #include <wx/fs_mem.h>
+#include <wx/stopwatch.h>
+#include <algorithm>
 
 #define SCROLL_UNIT 10
 #define CARET_TIMER_TIMEOUT 500
 #define ANIMATION_TIMER_TIMEOUT 300
+//! The number of milliseconds RecalculatePending() may block the GUI at once
+#define LAYOUT_BATCH_TIMEOUT 30
+//! How many screen heights above and below the viewport RecalculatePending() lays out
+#define LAYOUT_PREFETCH_SCREENS 2
 
 MathCtrl::MathCtrl(wxWindow* parent, int id, wxPoint position, wxSize size) :
 wxScrolledCanvas(
@@ -74,6 +81,10 @@ wxScrolledCanvas(
   m_answerCell = NULL;
   m_scrolledAwayFromEvaluation = false;
   m_keyboardInactive = true;
+  m_layoutPending = false;
+  m_viewportLayoutScheduled = false;
+  m_layoutIdleTop = m_layoutIdleHeight = -1;
+  m_layoutClientSize = wxDefaultSize;
   m_tree = NULL;
   m_mainToolBar = NULL;
   m_memory = NULL;
@@ -158,8 +169,13 @@ void MathCtrl::OnPaint(wxPaintEvent& event) {
   dcm.SetBackgroundMode(wxTRANSPARENT);
   dcm.SetLogicalFunction(wxCOPY);
 
+  int left, right, ystart;
+  CalcUnscrolledPosition(rect.GetLeft(), 0, &left, &ystart);
+  CalcUnscrolledPosition(rect.GetRight(), 0, &right, &ystart);
+
   CellParser parser(dcm);
   parser.SetBounds(top, bottom);
+  parser.SetHorizontalBounds(left, right);
   parser.SetZoomFactor(m_zoomFactor);
   int fontsize = parser.GetDefaultFontSize(); // apply zoomfactor to defaultfontsize
 
@@ -273,7 +289,20 @@ void MathCtrl::OnPaint(wxPaintEvent& event) {
       tmp->m_currentPoint.x = point.x;
       tmp->m_currentPoint.y = point.y;
       if (tmp->DrawThisCell(parser, point))
-        tmp->Draw(parser, point, MAX(fontsize, MC_MIN_SIZE));
+      {
+        // The contents of a cell whose layout is pending have outdated sizes
+        // and positions => the cell is drawn as soon as it has been laid out.
+        if (tmp->LayoutPending() && !tmp->LayoutIncomplete())
+        {
+          if (!m_viewportLayoutScheduled)
+          {
+            m_viewportLayoutScheduled = true;
+            CallAfter(&MathCtrl::LayOutViewport);
+          }
+        }
+        else
+          tmp->Draw(parser, point, MAX(fontsize, MC_MIN_SIZE));
+      }
       if (tmp->m_next != NULL) {
         point.x = MC_GROUP_LEFT_INDENT;
         point.y += drop + tmp->m_next->GetMaxCenter();
@@ -448,8 +477,15 @@ void MathCtrl::InsertLine(MathCell *newCell, bool forceNewLine)
     CellParser parser(dc);
     parser.SetZoomFactor(m_zoomFactor);
     parser.SetClientWidth(GetClientSize().GetWidth() - MC_GROUP_LEFT_INDENT - MC_BASE_INDENT);
+    parser.SetProgressiveLayout(true);
 
     tmp->RecalculateAppended(parser);
+    // The idle loop measures what has been left unmeasured.
+    if (tmp->LayoutPending())
+    {
+      m_layoutPending = true;
+      m_layoutIdleTop = -1;
+    }
     Recalculate();
 
     if(FollowEvaluation()) {
@@ -496,9 +532,28 @@ void MathCtrl::SetZoomFactor(double newzoom, bool recalc)
       CellToScrollTo = CellToScrollTo -> m_next;
     }
   }
+  double oldZoomFactor = m_zoomFactor;
   m_zoomFactor = newzoom;
   if (recalc)
   {
+    // Only the cells in the viewport are measured at the new size right away.
+    // The size of all other cells is scaled arithmetically so the scroll
+    // position and the scrollbars are right until RecalculatePending() reaches
+    // them. There is no zoom-independent copy of the layout: Each cell is
+    // measured again at the new zoom factor before it is drawn.
+    if (oldZoomFactor > 0)
+    {
+      int view_x, view_y;
+      GetViewStart(&view_x, &view_y);
+      GroupCell *tmp = m_tree;
+      while (tmp != NULL) {
+        tmp->ScaleLayout(newzoom / oldZoomFactor);
+        tmp = dynamic_cast<GroupCell*>(tmp->m_next);
+      }
+      UpdateCellPositions();
+      AdjustSize();
+      Scroll(-1, (int)(view_y * newzoom / oldZoomFactor + 0.5));
+    }
     RecalculateForce();
     Refresh();
   }
@@ -514,20 +569,84 @@ void MathCtrl::Recalculate(bool force)
   if(m_tree)
     m_tree->SetCanvasSize(GetClientSize());
 
+  // Re-measuring every cell of a big worksheet takes long. So we only
+  // invalidate the layout here, lay out the cells in the viewport right away
+  // and leave the rest to the idle loop.
+  if (force)
+  {
+    while (tmp != NULL) {
+      tmp->InvalidateLayout();
+      tmp = dynamic_cast<GroupCell*>(tmp->m_next);
+    }
+    m_layoutPending = (m_tree != NULL);
+    m_layoutIdleTop = -1;
+  }
+
   wxClientDC dc(this);
   CellParser parser(dc);
   parser.SetZoomFactor(m_zoomFactor);
-  parser.SetForceUpdate(force);
   parser.SetClientWidth(GetClientSize().GetWidth() - MC_GROUP_LEFT_INDENT - MC_BASE_INDENT);
+  parser.SetProgressiveLayout(true);
   int d_fontsize = parser.GetDefaultFontSize();
   int m_fontsize = parser.GetMathFontSize();
 
+  // Cells whose size is unknown (for example all cells of a file that has just
+  // been opened) get an estimated size for now. RecalculateVisible() and
+  // RecalculatePending() lay them out as soon as they come near the viewport.
+  tmp = m_tree;
+  while (tmp != NULL) {
+    if ((tmp->GetHeight() < 0) || (tmp->GetWidth() < 0))
+    {
+      tmp->EstimateSize(parser, d_fontsize, m_fontsize);
+      m_layoutPending = true;
+      m_layoutIdleTop = -1;
+    }
+    else if (!tmp->LayoutPending())
+      tmp->Recalculate(parser, d_fontsize, m_fontsize);
+    tmp = dynamic_cast<GroupCell*>(tmp->m_next);
+  }
+
+  UpdateCellPositions();
+  RecalculateVisible();
+  m_layoutClientSize = GetClientSize();
+  
+  AdjustSize();
+  // Re-calculate the table of contents
+  UpdateTableOfContents();
+}
+
+void MathCtrl::Reflow()
+{
+  if(m_tree)
+    m_tree->SetCanvasSize(GetClientSize());
+
+  wxClientDC dc(this);
+  CellParser parser(dc);
+  parser.SetZoomFactor(m_zoomFactor);
+  parser.SetClientWidth(GetClientSize().GetWidth() - MC_GROUP_LEFT_INDENT - MC_BASE_INDENT);
+
+  GroupCell *tmp = m_tree;
+  while (tmp != NULL) {
+    tmp->Reflow(parser);
+    tmp = dynamic_cast<GroupCell*>(tmp->m_next);
+  }
+
+  UpdateCellPositions();
+  RecalculateVisible();
+  m_layoutClientSize = GetClientSize();
+
+  AdjustSize();
+}
+
+void MathCtrl::UpdateCellPositions()
+{
+  GroupCell *tmp = m_tree;
+
   wxPoint point;
   point.x = MC_GROUP_LEFT_INDENT;
   point.y = MC_BASE_INDENT ;
 
   while (tmp != NULL) {
-    tmp->Recalculate(parser, d_fontsize, m_fontsize);
     point.y += tmp->GetMaxCenter();
     tmp->m_currentPoint.x = point.x;
     tmp->m_currentPoint.y = point.y;
@@ -535,10 +654,233 @@ void MathCtrl::Recalculate(bool force)
     tmp = dynamic_cast<GroupCell*>(tmp->m_next);
     point.y += MC_GROUP_SKIP;
   }
-  
-  AdjustSize();
-  // Re-calculate the table of contents
-  UpdateTableOfContents();
+}
+
+bool MathCtrl::RecalculateVisible()
+{
+  if (!m_layoutPending)
+    return false;
+
+  wxClientDC dc(this);
+  CellParser parser(dc);
+  parser.SetZoomFactor(m_zoomFactor);
+  parser.SetClientWidth(GetClientSize().GetWidth() - MC_GROUP_LEFT_INDENT - MC_BASE_INDENT);
+  parser.SetProgressiveLayout(true);
+  int d_fontsize = parser.GetDefaultFontSize();
+  int m_fontsize = parser.GetMathFontSize();
+
+  int top, bottom, x;
+  CalcUnscrolledPosition(0, 0, &x, &top);
+  bottom = top + GetClientSize().GetHeight();
+
+  // Laying out a cell changes its size and therefore moves the cells below it.
+  // So we repeat until all cells in the viewport have been laid out.
+  bool laidOut = false;
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    GroupCell *tmp = m_tree;
+    while (tmp != NULL) {
+      wxRect rect = tmp->GetRect();
+      if (rect.GetTop() > bottom)
+        break;
+      // Cells that have been laid out only partially are completed by the
+      // idle loop: Doing so here would measure everything in one go.
+      if ((rect.GetBottom() >= top) && tmp->LayoutPending() && !tmp->LayoutIncomplete())
+      {
+        tmp->Recalculate(parser, d_fontsize, m_fontsize);
+        changed = true;
+      }
+      tmp = dynamic_cast<GroupCell*>(tmp->m_next);
+    }
+    if (changed)
+    {
+      UpdateCellPositions();
+      laidOut = true;
+    }
+  }
+  return laidOut;
+}
+
+void MathCtrl::ScrollWindow(int dx, int dy, const wxRect *rect)
+{
+  wxScrolledCanvas::ScrollWindow(dx, dy, rect);
+
+  // The user might have scrolled to cells that haven't been laid out yet.
+  if (m_layoutPending && !m_viewportLayoutScheduled)
+  {
+    m_viewportLayoutScheduled = true;
+    CallAfter(&MathCtrl::LayOutViewport);
+  }
+}
+
+void MathCtrl::LayOutViewport()
+{
+  m_viewportLayoutScheduled = false;
+  if (RecalculateVisible())
+  {
+    AdjustSize();
+    Refresh();
+  }
+}
+
+void MathCtrl::LayOutViewportNow()
+{
+  if (RecalculateVisible())
+  {
+    AdjustSize();
+    Refresh();
+    Update();
+  }
+}
+
+void MathCtrl::LayOutCell(GroupCell *cell)
+{
+  if (cell == NULL)
+    return;
+
+  wxClientDC dc(this);
+  CellParser parser(dc);
+  parser.SetZoomFactor(m_zoomFactor);
+  parser.SetClientWidth(GetClientSize().GetWidth() - MC_GROUP_LEFT_INDENT - MC_BASE_INDENT);
+  parser.SetProgressiveLayout(true);
+
+  // A cell that has been laid out partially already has a consistent layout
+  // that the idle loop completes.
+  if (cell->LayoutPending() && !cell->LayoutIncomplete())
+  {
+    cell->Recalculate(parser, parser.GetDefaultFontSize(), parser.GetMathFontSize());
+    UpdateCellPositions();
+    AdjustSize();
+  }
+  cell->UpdateChildPositions(parser);
+}
+
+bool MathCtrl::RecalculatePending()
+{
+  if (!m_layoutPending)
+    return false;
+
+  int top, x;
+  CalcUnscrolledPosition(0, 0, &x, &top);
+  int height = GetClientSize().GetHeight();
+  int bottom = top + height;
+
+  // The cells that still are pending are far away from this viewport.
+  if ((top == m_layoutIdleTop) && (height == m_layoutIdleHeight))
+    return false;
+
+  // Cells far away from the viewport keep their estimated size until the
+  // user scrolls near them.
+  int prefetchTop = top - LAYOUT_PREFETCH_SCREENS * height;
+  int prefetchBottom = bottom + LAYOUT_PREFETCH_SCREENS * height;
+
+  // Remember where the topmost visible cell is so it can be kept in place
+  // if the cells above it change their size.
+  GroupCell *anchor = m_tree;
+  while ((anchor != NULL) && (anchor->GetRect().GetBottom() < top))
+    anchor = dynamic_cast<GroupCell*>(anchor->m_next);
+  int anchorY = -1;
+  if (anchor != NULL)
+    anchorY = anchor->GetCurrentY();
+
+  wxClientDC dc(this);
+  CellParser parser(dc);
+  parser.SetZoomFactor(m_zoomFactor);
+  parser.SetClientWidth(GetClientSize().GetWidth() - MC_GROUP_LEFT_INDENT - MC_BASE_INDENT);
+  parser.SetProgressiveLayout(true);
+  int d_fontsize = parser.GetDefaultFontSize();
+  int m_fontsize = parser.GetMathFontSize();
+
+  wxStopWatch stopwatch;
+  bool done = true;
+  bool laidOut = false;
+  bool visibleLaidOut = false;
+
+  // The cells below the viewport come first as laying them out doesn't move
+  // anything the user currently sees.
+  GroupCell *tmp = anchor;
+  while ((tmp != NULL) && done && (tmp->GetRect().GetTop() <= prefetchBottom)) {
+    if (tmp->LayoutPending())
+    {
+      if (stopwatch.Time() > LAYOUT_BATCH_TIMEOUT)
+        done = false;
+      else
+      {
+        tmp->Recalculate(parser, d_fontsize, m_fontsize);
+        laidOut = true;
+        if ((tmp->GetRect().GetTop() <= bottom) && (tmp->GetRect().GetBottom() >= top))
+          visibleLaidOut = true;
+        // A cell that has been laid out only partially needs more passes.
+        if (tmp->LayoutPending())
+          done = false;
+      }
+    }
+    tmp = dynamic_cast<GroupCell*>(tmp->m_next);
+  }
+
+  tmp = m_tree;
+  while ((tmp != NULL) && (tmp != anchor) && done) {
+    if (tmp->LayoutPending() && (tmp->GetRect().GetBottom() >= prefetchTop))
+    {
+      if (stopwatch.Time() > LAYOUT_BATCH_TIMEOUT)
+        done = false;
+      else
+      {
+        tmp->Recalculate(parser, d_fontsize, m_fontsize);
+        laidOut = true;
+        if ((tmp->GetRect().GetTop() <= bottom) && (tmp->GetRect().GetBottom() >= top))
+          visibleLaidOut = true;
+        // A cell that has been laid out only partially needs more passes.
+        if (tmp->LayoutPending())
+          done = false;
+      }
+    }
+    tmp = dynamic_cast<GroupCell*>(tmp->m_next);
+  }
+
+  if (laidOut)
+  {
+    UpdateCellPositions();
+
+    if ((anchor != NULL) && (anchor->GetCurrentY() != anchorY))
+    {
+      int view_x, view_y;
+      GetViewStart(&view_x, &view_y);
+      AdjustSize();
+      Scroll(-1, MAX(0, view_y + (anchor->GetCurrentY() - anchorY) / SCROLL_UNIT));
+      Refresh();
+    }
+    else
+    {
+      AdjustSize();
+      if (visibleLaidOut)
+        Refresh();
+    }
+  }
+
+  if (done)
+  {
+    // Are there cells left that still have only an estimated size?
+    m_layoutPending = false;
+    tmp = m_tree;
+    while ((tmp != NULL) && !m_layoutPending) {
+      m_layoutPending = tmp->LayoutPending();
+      tmp = dynamic_cast<GroupCell*>(tmp->m_next);
+    }
+    if (laidOut)
+      UpdateTableOfContents();
+
+    // Don't search the worksheet again on every idle event until the user
+    // scrolls or the layout is invalidated again.
+    if (m_layoutPending)
+    {
+      m_layoutIdleTop = top;
+      m_layoutIdleHeight = height;
+    }
+  }
+  return !done;
 }
 
 /***
@@ -570,9 +912,11 @@ void MathCtrl::OnSize(wxSizeEvent& event) {
     }
   }
 
-  if (m_tree != NULL) {
+  // A new window size doesn't change the size of text => the cells only need
+  // to be re-broken into lines, not re-measured.
+  if ((m_tree != NULL) && (GetClientSize() != m_layoutClientSize)) {
     SetSelection(NULL);
-    RecalculateForce();
+    Reflow();
   }
   else
     AdjustSize();
@@ -782,6 +1126,7 @@ void MathCtrl::OnMouseRightDown(wxMouseEvent& event) {
   // find out if clicked into existing selection, if not, reselect with leftdown
   //
   bool clickInSelection = false;
+  LayOutViewportNow();
   CalcUnscrolledPosition(event.GetX(), event.GetY(), &downx, &downy);
   if ((m_selectionStart != NULL)) {
     // SELECTION OF GROUPCELLS
@@ -1099,6 +1444,8 @@ void MathCtrl::OnMouseLeftDown(wxMouseEvent& event) {
   if (m_tree == NULL)
     return ;
 
+  LayOutViewportNow();
+
   // default when clicking
   m_clickType = CLICK_TYPE_NONE;
   SetSelection(NULL);
@@ -1221,6 +1568,7 @@ void MathCtrl::OnMouseMotion(wxMouseEvent& event) {
   if (m_tree == NULL || !m_leftDown)
     return;
   m_mouseDrag = true;
+  LayOutViewportNow();
   CalcUnscrolledPosition(event.GetX(), event.GetY(), &m_up.x, &m_up.y);
   if (m_mouseOutside) {
     m_mousePoint.x = event.GetX();
@@ -1748,10 +2096,8 @@ void MathCtrl::DeleteRegion(GroupCell *start,GroupCell *end,std::list <TreeUndoA
     if(tmp==m_lastWorkingGroup)
       m_lastWorkingGroup = NULL;
     
-    if (tmp->IsFoldable() || (tmp->GetGroupType() == GC_TYPE_IMAGE)) {
+    if (tmp->IsFoldable() || (tmp->GetGroupType() == GC_TYPE_IMAGE))
       renumber = true;
-      break;
-    }
 
     // Don't keep cached versions of scaled images around in the undo buffer.
     if(tmp->GetOutput())
@@ -3704,8 +4050,17 @@ bool MathCtrl::ExportToHTML(wxString file) {
               chunkEnd = chunkEnd->m_next;
             }
           
-          // Create a list containing only our chunk.
-          MathCell *chunk = CopySelection(chunkStart,chunkEnd,true);
+          // Images and animations are exported directly from the worksheet.
+          // Only lists of math cells need to be copied into a list of their
+          // own that ends with this chunk.
+          MathCell *chunk = chunkStart;
+          bool chunkIsCopy = false;
+          if((chunkStart->GetType() != MC_TYPE_SLIDE) &&
+             (chunkStart->GetType() != MC_TYPE_IMAGE))
+          {
+            chunk = CopySelection(chunkStart,chunkEnd,true);
+            chunkIsCopy = true;
+          }
 
           // Export the chunk.
           if(chunk->GetType() == MC_TYPE_SLIDE)
@@ -3728,9 +4083,13 @@ bool MathCtrl::ExportToHTML(wxString file) {
           {
             wxString ext;
             wxSize size;
+            int borderwidth = 0;
+            wxString alttext = _("Result");
             // Something we want to export as an image.
             if(chunk->GetType() == MC_TYPE_IMAGE)
             {
+              alttext = chunk->ToString();
+              borderwidth = chunk->m_imageBorderWidth;
               ext=wxString::Format(wxT("_%d."), count);
               size = dynamic_cast<ImgCell*>(chunk)->ToImageFile(
                 imgDir + wxT("/") + filename + ext +
@@ -3738,20 +4097,21 @@ bool MathCtrl::ExportToHTML(wxString file) {
             }
             else
             {
+              alttext = chunk->ListToString();
+              borderwidth = chunk->m_imageBorderWidth;
               int bitmapScale = 3;
               ext=wxT(".png");
               wxConfig::Get()->Read(wxT("bitmapScale"), &bitmapScale);
-              size = CopyToFile(imgDir + wxT("/") + filename + wxString::Format(wxT("_%d.png"), count),
-                                chunk,
-                                NULL, true, bitmapScale);
+              // The bitmap takes over our copy of the chunk instead of
+              // creating a second one.
+              Bitmap bmp(bitmapScale);
+              bmp.SetData(chunk);
+              chunk = NULL;
+              size = bmp.ToFile(imgDir + wxT("/") + filename + wxString::Format(wxT("_%d.png"), count));
             }
             
-            int borderwidth = 0;
-            wxString alttext = _("Result");
-            alttext = chunk->ListToString();
 //            alttext.Replace(wxT("\n"),wxT(" "));
             alttext = EditorCell::EscapeHTMLChars(alttext);
-            borderwidth = chunk->m_imageBorderWidth;
             
             wxString line = wxT("  <img src=\"") +
               filename + wxT("_htmlimg/") + filename +
@@ -3765,7 +4125,8 @@ bool MathCtrl::ExportToHTML(wxString file) {
           count++;
 
           // Prepare for fetching the next chunk.
-          chunk->DestroyList();
+          if(chunkIsCopy && (chunk != NULL))
+            chunk->DestroyList();
           chunkStart = chunkEnd->m_next;
         }
       }
@@ -4848,11 +5209,16 @@ void MathCtrl::ScrollToCell(MathCell *cell)
   if (tmp == NULL)
     return;
 
+  // The position of a cell whose layout is pending is only an estimate.
+  GroupCell *group = dynamic_cast<GroupCell*>(tmp);
+  if ((group != NULL) && group->LayoutPending())
+    LayOutCell(group);
+
   int cellY = tmp->GetCurrentY();
 
   if (cellY < 1)
   {
-    RecalculateForce();
+    LayOutCell(group);
     cellY = tmp->GetCurrentY();
 
     if(cellY < 1)
@@ -4901,13 +5267,42 @@ void MathCtrl::TreeUndo_LimitUndoBuffer()
 {
   
   wxConfigBase *config = wxConfig::Get();
-  int undoLimit;
+  int undoLimit = 0;
   config->Read(wxT("undoLimit"),&undoLimit);
 
-  if(undoLimit == 0)
+  if(undoLimit > 0)
+  {
+    while(treeUndoActions.size() > undoLimit)
+      TreeUndo_DiscardAction(&treeUndoActions);
+  }
+
+  int treeUndoMemory = MATHCTRL_UNDO_MEMORY_DEFAULT;
+  config->Read(wxT("treeUndoMemory"),&treeUndoMemory);
+  if(treeUndoMemory <= 0)
     return;
-  while(treeUndoActions.size() > undoLimit)
+  size_t memoryLimit = ((size_t) treeUndoMemory) * 1024;
+
+  size_t size = 0;
+  for(std::list<TreeUndoAction *>::iterator it = treeUndoActions.begin();
+      it != treeUndoActions.end(); ++it)
+    size += TreeUndo_ActionSize(*it);
+
+  // The newest action is kept even if it exceeds the limit on its own.
+  while((size > memoryLimit) && (treeUndoActions.size() > 1))
+  {
+    size -= TreeUndo_ActionSize(treeUndoActions.back());
     TreeUndo_DiscardAction(&treeUndoActions);
+  }
+}
+
+size_t MathCtrl::TreeUndo_ActionSize(TreeUndoAction *action)
+{
+  // The cells of an action don't change while it is in the undo buffer.
+  if(action->m_size == 0)
+    action->m_size = sizeof(TreeUndoAction) +
+      action->m_oldText.Length() * sizeof(wxChar) +
+      MathCell::GetListMemorySize(action->m_oldCells);
+  return action->m_size;
 }
 
 bool MathCtrl::CanTreeUndo(){
@@ -5826,6 +6221,12 @@ bool MathCtrl::FindNext(wxString str, bool down, bool ignoreCase)
   if(pos == NULL)
     return false;
   
+  // Only the cells the index lists can contain the string.
+  std::vector<EditorCell *> candidates;
+  bool indexed = SearchIndex::Candidates(str, candidates);
+  if (indexed && candidates.empty())
+    return false;
+
   // Remember where to go if we need to wrapp the search.
   GroupCell *start = pos;
 
@@ -5835,7 +6236,8 @@ bool MathCtrl::FindNext(wxString str, bool down, bool ignoreCase)
   {
     EditorCell *editor = (EditorCell *)(pos->GetEditable());
     
-    if (editor != NULL)
+    if ((editor != NULL) &&
+        (!indexed || std::binary_search(candidates.begin(), candidates.end(), editor)))
     {
       bool found = editor->FindNext(str, down, ignoreCase);
       
@@ -5902,7 +6304,7 @@ bool MathCtrl::CaretVisibleIs()
       wxPoint point = GetActiveCell()->PositionToPoint(parser, -1);
       if(point.y<1)
       {
-        RecalculateForce();
+        LayOutCell(dynamic_cast<GroupCell*>(GetActiveCell()->GetParent()));
         point = GetActiveCell()->PositionToPoint(parser, -1);
       }
       return PointVisibleIs(point);
@@ -5923,12 +6325,17 @@ void MathCtrl::ScrollToCaret()
   {
     if(m_activeCell)
     {
+      // The position of the caret is outdated if its GroupCell hasn't been
+      // laid out or hasn't been drawn since the cells above it changed.
+      GroupCell *group = dynamic_cast<GroupCell*>(GetActiveCell()->GetParent());
+      LayOutCell(group);
+
       wxClientDC dc(this);
       CellParser parser(dc);
       wxPoint point = GetActiveCell()->PositionToPoint(parser, -1);
       if(point.y<1)
       {
-        RecalculateForce();
+        LayOutCell(group);
         ScrollToCell(GetActiveCell()->GetParent());
         point = GetActiveCell()->PositionToPoint(parser, -1);
         if(point.y<1)
@@ -5960,13 +6367,19 @@ int MathCtrl::ReplaceAll(wxString oldString, wxString newString, bool ignoreCase
 
   int count = 0;
 
+  std::vector<EditorCell *> candidates;
+  bool indexed = SearchIndex::Candidates(oldString, candidates);
+  if (indexed && candidates.empty())
+    return 0;
+
   GroupCell *tmp = m_tree;
 
   while (tmp != NULL)
   {
     EditorCell *editor = (EditorCell *)(tmp->GetEditable());
 
-    if (editor != NULL)
+    if ((editor != NULL) &&
+        (!indexed || std::binary_search(candidates.begin(), candidates.end(), editor)))
     {
       int replaced = editor->ReplaceAll(oldString, newString, ignoreCase);
       if (replaced > 0)
@@ -5974,7 +6387,6 @@ int MathCtrl::ReplaceAll(wxString oldString, wxString newString, bool ignoreCase
         count += replaced;
         tmp->ResetInputLabel();
       }
-      count += editor->ReplaceAll(oldString, newString, ignoreCase);
     }
 
     tmp = dynamic_cast<GroupCell*>(tmp->m_next);
@@ -5990,6 +6402,32 @@ int MathCtrl::ReplaceAll(wxString oldString, wxString newString, bool ignoreCase
   return count;
 }
 
+int MathCtrl::CountMatches(wxString str, bool ignoreCase)
+{
+  std::vector<EditorCell *> candidates;
+  bool indexed = SearchIndex::Candidates(str, candidates);
+  if (indexed && candidates.empty())
+    return 0;
+
+  int count = 0;
+  GroupCell *tmp = m_tree;
+  while (tmp != NULL)
+  {
+    EditorCell *editor = (EditorCell *)(tmp->GetEditable());
+    if ((editor != NULL) &&
+        (!indexed || std::binary_search(candidates.begin(), candidates.end(), editor)))
+      count += editor->CountMatches(str, ignoreCase);
+    tmp = dynamic_cast<GroupCell*>(tmp->m_next);
+  }
+  return count;
+}
+
+void MathCtrl::HighlightMatches(wxString str, bool ignoreCase)
+{
+  EditorCell::SetSearchString(str, ignoreCase);
+  Refresh();
+}
+
 bool MathCtrl::Autocomplete(AutoComplete::autoCompletionType type)
 {
   if (m_activeCell == NULL)
@@ -6046,7 +6484,6 @@ bool MathCtrl::Autocomplete(AutoComplete::autoCompletionType type)
   wxString partial = editor->GetSelectionString();
 
   m_completions = m_autocomplete.CompleteSymbol(partial, type);
-  m_completions.Sort();
   m_autocompleteTemplates = (type == AutoComplete::tmplte);
 
   /// No completions - clear the selection and return false
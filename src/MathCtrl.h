@@ -38,6 +38,9 @@
 #include "Structure.h"
 #include "ToolBar.h"
 
+//! The memory the undo buffer of the worksheet may use in kB if nothing else is configured
+#define MATHCTRL_UNDO_MEMORY_DEFAULT 10240
+
 /*! The canvas that contains the spreadsheet the whole program is about.
 
 This canvas contains all the math, title, image etc.- cells of the current session.
@@ -81,6 +84,7 @@ private:
           m_oldText=wxEmptyString;
           m_newCellsEnd=NULL;
           m_oldCells=NULL;
+          m_size=0;
         }
       
       TreeUndoAction(){ Clear(); }
@@ -115,6 +119,9 @@ private:
         If this field's value is NULL no cells have to be added to undo this action.
       */
       GroupCell *m_oldCells;
+
+      //! The estimated memory this action occupies. 0 = not calculated yet.
+      size_t m_size;
     };
 
   //! The list of tree actions that can be undone
@@ -141,6 +148,9 @@ private:
   //! Drop actions from the back of the undo list until itis within the undo limit.
   void TreeUndo_LimitUndoBuffer();
 
+  //! Estimate the memory an undo action occupies
+  size_t TreeUndo_ActionSize(TreeUndoAction *action);
+
   /*! Undo an item from a list of undo actions.
 
     \param actionlist The list to take the undo information from
@@ -274,6 +284,35 @@ private:
   MathCell* CopySelection(MathCell* start, MathCell* end, bool asData = false);
   
   void GetMaxPoint(int* width, int* height);
+  //! Recalculate the y positions of all GroupCells from their heights
+  void UpdateCellPositions();
+  /*! Lay out all GroupCells in the viewport whose layout still is pending
+
+    \return true, if any cell has been laid out.
+   */
+  bool RecalculateVisible();
+  /*! Lay out the cells that have been scrolled into the viewport
+
+    Is called after the scroll has happened. Changing the scrollbars from within
+    the paint handler would cause new size and paint events.
+   */
+  void LayOutViewport();
+  /*! Lay out one GroupCell now and update the positions that depend on it
+
+    Used before scrolling to a cell or to the caret inside it: A cell whose
+    layout still is pending only has an estimated size and its contents don't
+    have valid positions.
+   */
+  void LayOutCell(GroupCell *cell);
+  /*! Lay out and draw the cells in the viewport whose layout still is pending
+
+    Hit-testing uses the positions the contents of a cell got when the cell was
+    drawn. Cells that have just been scrolled into view might not have been
+    laid out and drawn yet, so this is done before a mouse click is processed.
+   */
+  void LayOutViewportNow();
+  //! Scrolls the window and schedules laying out the cells that come into view
+  virtual void ScrollWindow(int dx, int dy, const wxRect *rect = NULL);
   //! Is executed if a timer associated with MathCtrl has expired.
   void OnTimer(wxTimerEvent& event);
   /*! Has the autosave interval expired?
@@ -439,6 +478,20 @@ public:
     used by UpdateTableOfContents() and the idle task.
   */
   bool m_scheduleUpdateToc;
+  /*! True = there are GroupCells whose layout has been invalidated
+
+    used by Recalculate() and RecalculatePending().
+  */
+  bool m_layoutPending;
+  /*! The viewport RecalculatePending() has found nothing to lay out near
+
+    -1 = RecalculatePending() has to search for pending cells again.
+   */
+  int m_layoutIdleTop, m_layoutIdleHeight;
+  //! Is a call to LayOutViewport() already queued?
+  bool m_viewportLayoutScheduled;
+  //! The client size the current layout has been calculated for
+  wxSize m_layoutClientSize;
   //! Is the vertically-drawn cursor active?
   bool HCaretActive(){return m_hCaretActive;}
   /*! Can we merge the selected cells into one?
@@ -546,10 +599,34 @@ public:
     the line is appended to m_last, instead.
   */
   void InsertLine(MathCell *newLine, bool forceNewLine = false);
+  /*! Recalculate the layout of the worksheet
+
+    \param force
+     - false: Only lay out the cells whose size is unknown.
+     - true: Re-measure all cells.
+
+    Only the cells in the viewport are laid out immediately. All other cells
+    keep their old or an estimated size until RecalculatePending() reaches them.
+   */
   void Recalculate(bool force = false);  
   void RecalculateForce() {
     Recalculate(true);
   }
+  /*! Lay out a batch of the GroupCells near the viewport whose layout still is pending
+
+    Called from the idle loop. Cells far away from the viewport are left alone
+    until the user scrolls near them.
+
+    \return true, if there still are cells near the viewport that wait for
+    being laid out.
+   */
+  bool RecalculatePending();
+  /*! Adapt the layout to a changed window size
+
+    Only re-runs the line breaking, the scaling of images and the calculation
+    of the cell positions and keeps all other cached sizes.
+   */
+  void Reflow();
   /*! Empties the current document
 
     Used before opening a new file or when the "new" button is pressed.
@@ -817,11 +894,23 @@ public:
     Used by the find dialog.
    */
   int ReplaceAll(wxString oldString, wxString newString, bool ignoreCase);
+  /*! Count the occurrences of a string in the whole worksheet
+
+    Used by the find dialog.
+   */
+  int CountMatches(wxString str, bool ignoreCase);
+  /*! Highlight all occurrences of a string in the worksheet
+
+    Used by the find dialog. An empty string turns the highlighting off.
+   */
+  void HighlightMatches(wxString str, bool ignoreCase);
   wxString GetInputAboveCaret();
   wxString GetOutputAboveCaret();
   bool LoadSymbols(wxString file) { return m_autocomplete.LoadSymbols(file); }
   bool Autocomplete(AutoComplete::autoCompletionType type = AutoComplete::command);
   void AddSymbol(wxString fun, AutoComplete::autoCompletionType type = AutoComplete::command) { m_autocomplete.AddSymbol(fun, type); }
+  //! Count the uses of the symbols in a command for ranking completions
+  void CountSymbolUsage(wxString command, int weight = 1) { m_autocomplete.CountUsage(command, weight); }
   void SetActiveCellText(wxString text);
   bool InsertText(wxString text);
   GroupCell *GetWorkingGroup() { return m_workingGroup; }
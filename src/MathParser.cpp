@@ -53,6 +53,7 @@ MathParser::MathParser(wxString zipfile)
   m_ParserStyle = MC_TYPE_DEFAULT;
   m_FracStyle = FracCell::FC_NORMAL;
   m_highlight = false;
+  ReadDisplayedDigits();
   if (zipfile.Length() > 0) {
     m_fileSystem = new wxFileSystem();
     m_fileSystem->ChangePathTo(zipfile + wxT("#zip:/"), true);
@@ -67,6 +68,15 @@ MathParser::~MathParser()
     delete m_fileSystem;
 }
 
+void MathParser::ReadDisplayedDigits()
+{
+  m_displayedDigits = 100;
+  wxConfigBase *config = wxConfig::Get();
+  config->Read(wxT("displayedDigits"), &m_displayedDigits);
+
+  if (m_displayedDigits < 10) m_displayedDigits = 10;
+}
+
 // ParseCellTag
 // This function is responsible for creating
 // a tree of groupcells when loading XML document.
@@ -404,11 +414,6 @@ MathCell* MathParser::ParseText(wxXmlNode* node, int style)
 #endif
     if (style == TS_NUMBER)
     {
-      m_displayedDigits=100;
-      wxConfigBase *config = wxConfig::Get();      
-      config->Read(wxT("displayedDigits"),&m_displayedDigits);
-
-      if (m_displayedDigits<10)m_displayedDigits=10;
       if (str.Length() > m_displayedDigits)
 	{
 	  int left= m_displayedDigits/3;
@@ -640,8 +645,7 @@ MathCell* MathParser::ParseTableTag(wxXmlNode* node)
 MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
 {
   //  wxYield();
-  MathCell* tmp = NULL;
-  MathCell* cell = NULL;
+  CellListBuilder cells;
   bool warning = all;
   wxString altCopy;
 
@@ -654,10 +658,7 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
 
       if (tagName == wxT("v"))
       {               // Variables (atoms)
-        if (cell == NULL)
-          cell = ParseText(node->GetChildren(), TS_VARIABLE);
-        else
-          cell->AppendCell(ParseText(node->GetChildren(), TS_VARIABLE));
+        cells.Append(ParseText(node->GetChildren(), TS_VARIABLE));
       }
       else if (tagName == wxT("t"))
       {          // Other text
@@ -665,169 +666,100 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
         if(node->GetAttribute(wxT("type")) == wxT("error"))
           style = TS_ERROR;
 
-        if (cell == NULL)
-          cell = ParseText(node->GetChildren(), style);
-        else
-          cell->AppendCell(ParseText(node->GetChildren(), style));
+        cells.Append(ParseText(node->GetChildren(), style));
       }
       else if (tagName == wxT("n"))
       {          // Numbers
-        if (cell == NULL)
-          cell = ParseText(node->GetChildren(), TS_NUMBER);
-        else
-          cell->AppendCell(ParseText(node->GetChildren(), TS_NUMBER));
+        cells.Append(ParseText(node->GetChildren(), TS_NUMBER));
       }
       else if (tagName == wxT("h"))
       {          // Hidden cells (*)
         MathCell* tmp = ParseText(node->GetChildren());
         tmp->m_isHidden = true;
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        cells.Append(tmp);
       }
       else if (tagName == wxT("p"))
       {          // Parenthesis
-        if (cell == NULL)
-          cell = ParseParenTag(node);
-        else
-          cell->AppendCell(ParseParenTag(node));
+        cells.Append(ParseParenTag(node));
       }
       else if (tagName == wxT("f"))
       {               // Fractions
-        if (cell == NULL)
-          cell = ParseFracTag(node);
-        else
-          cell->AppendCell(ParseFracTag(node));
+        cells.Append(ParseFracTag(node));
       }
       else if (tagName == wxT("e"))
       {          // Exponentials
-        if (cell == NULL)
-          cell = ParseSupTag(node);
-        else
-          cell->AppendCell(ParseSupTag(node));
+        cells.Append(ParseSupTag(node));
       }
       else if (tagName == wxT("i"))
       {          // Subscripts
-        if (cell == NULL)
-          cell = ParseSubTag(node);
-        else
-          cell->AppendCell(ParseSubTag(node));
+        cells.Append(ParseSubTag(node));
       }
       else if (tagName == wxT("fn"))
       {         // Functions
-        if (cell == NULL)
-          cell = ParseFunTag(node);
-        else
-          cell->AppendCell(ParseFunTag(node));
+        cells.Append(ParseFunTag(node));
       }
       else if (tagName == wxT("g"))
       {          // Greek constants
         MathCell* tmp = ParseText(node->GetChildren(), TS_GREEK_CONSTANT);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        cells.Append(tmp);
       }
       else if (tagName == wxT("s"))
       {          // Special constants %e,...
         MathCell* tmp = ParseText(node->GetChildren(), TS_SPECIAL_CONSTANT);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        cells.Append(tmp);
       }
       else if (tagName == wxT("fnm"))
       {         // Function names
         MathCell* tmp = ParseText(node->GetChildren(), TS_FUNCTION);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        cells.Append(tmp);
       }
       else if (tagName == wxT("q"))
       {          // Square roots
-        if (cell == NULL)
-          cell = ParseSqrtTag(node);
-        else
-          cell->AppendCell(ParseSqrtTag(node));
+        cells.Append(ParseSqrtTag(node));
       }
       else if (tagName == wxT("d"))
       {          // Differentials
-        if (cell == NULL)
-          cell = ParseDiffTag(node);
-        else
-          cell->AppendCell(ParseDiffTag(node));
+        cells.Append(ParseDiffTag(node));
       }
       else if (tagName == wxT("sm"))
       {         // Sums
-        if (cell == NULL)
-          cell = ParseSumTag(node);
-        else
-          cell->AppendCell(ParseSumTag(node));
+        cells.Append(ParseSumTag(node));
       }
       else if (tagName == wxT("in"))
       {         // integrals
-        if (cell == NULL)
-          cell = ParseIntTag(node);
-        else
-          cell->AppendCell(ParseIntTag(node));
+        cells.Append(ParseIntTag(node));
       }
       else if (tagName == wxT("mspace"))
       {
-        if (cell == NULL)
-          cell = new TextCell(wxT(" "));
-        else
-          cell->AppendCell(new TextCell(wxT(" ")));
+        cells.Append(new TextCell(wxT(" ")));
       }
       else if (tagName == wxT("at"))
       {
-        if (cell == NULL)
-          cell = ParseAtTag(node);
-        else
-          cell->AppendCell(ParseAtTag(node));
+        cells.Append(ParseAtTag(node));
       }
       else if (tagName == wxT("a"))
       {
-        if (cell == NULL)
-          cell = ParseAbsTag(node);
-        else
-          cell->AppendCell(ParseAbsTag(node));
+        cells.Append(ParseAbsTag(node));
       }
       else if (tagName == wxT("cj"))
       {
-        if (cell == NULL)
-          cell = ParseConjugateTag(node);
-        else
-          cell->AppendCell(ParseConjugateTag(node));
+        cells.Append(ParseConjugateTag(node));
       }
       else if (tagName == wxT("ie"))
       {
-        if (cell == NULL)
-          cell = ParseSubSupTag(node);
-        else
-          cell->AppendCell(ParseSubSupTag(node));
+        cells.Append(ParseSubSupTag(node));
       }
       else if (tagName == wxT("lm"))
       {
-        if (cell == NULL)
-          cell = ParseLimitTag(node);
-        else
-          cell->AppendCell(ParseLimitTag(node));
+        cells.Append(ParseLimitTag(node));
       }
       else if (tagName == wxT("r"))
       {
-        if (cell == NULL)
-          cell = ParseTag(node->GetChildren());
-        else
-          cell->AppendCell(ParseTag(node->GetChildren()));
+        cells.Append(ParseTag(node->GetChildren()));
       }
       else if (tagName == wxT("tb"))
       {
-        if (cell == NULL)
-          cell = ParseTableTag(node);
-        else
-          cell->AppendCell(ParseTableTag(node));
+        cells.Append(ParseTableTag(node));
       }
       else if ((tagName == wxT("mth")) || (tagName == wxT("line")))
       {
@@ -836,10 +768,7 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
           tmp->ForceBreakLine(true);
         else
           tmp = new TextCell(wxT(" "));
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        cells.Append(tmp);
       }
       else if (tagName == wxT("lbl"))
       {
@@ -849,18 +778,12 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
         else
           tmp = ParseText(node->GetChildren(), TS_USERLABEL);
         tmp->ForceBreakLine(true);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        cells.Append(tmp);
       }
       else if (tagName == wxT("st"))
       {
         MathCell* tmp = ParseText(node->GetChildren(), TS_STRING);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        cells.Append(tmp);
       }
       else if (tagName == wxT("hl"))
       {
@@ -868,10 +791,7 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
         m_highlight = true;
         MathCell* tmp = ParseTag(node->GetChildren());
         m_highlight = highlight;
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        cells.Append(tmp);
       }
       else if (tagName == wxT("img"))
       {
@@ -893,10 +813,7 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
         if (node->GetAttribute(wxT("rect"), wxT("true")) == wxT("false"))
           tmp->DrawRectangle(false);
 
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        cells.Append(tmp);
       }
       else if (tagName == wxT("slide"))
       {
@@ -923,76 +840,47 @@ MathCell* MathParser::ParseTag(wxXmlNode* node, bool all)
           }
         }
         tmp->LoadImages(images);
-        if (cell == NULL)
-          cell = tmp;
-        else
-          cell->AppendCell(tmp);
+        cells.Append(tmp);
       }
       else if (tagName == wxT("editor"))
       {
-        if (cell == NULL)
-          cell = ParseEditorTag(node);
-        else
-          cell->AppendCell(ParseEditorTag(node));
+        cells.Append(ParseEditorTag(node));
       }
       else if (tagName == wxT("cell"))
       {
-        if (cell == NULL)
-          cell = ParseCellTag(node);
-        else
-          cell->AppendCell(ParseCellTag(node));
+        cells.Append(ParseCellTag(node));
       }
       else if (tagName == wxT("ascii"))
       {
-        if (cell == NULL)
-          cell = ParseCharCode(node->GetChildren());
-        else
-          cell->AppendCell(ParseCharCode(node->GetChildren()));
+        cells.Append(ParseCharCode(node->GetChildren()));
       }
       else if (node->GetChildren())
       {
-        if (cell == NULL)
-          cell = ParseTag(node->GetChildren());
-        else
-          cell->AppendCell(ParseTag(node->GetChildren()));
+        cells.Append(ParseTag(node->GetChildren()));
       }
     }
     // Parse text
     else
     {
-      if (cell == NULL)
-        cell = ParseText(node);
-      else
-        cell->AppendCell(ParseText(node));
+      cells.Append(ParseText(node));
     }
     if (!all)
       break;
 
-    if (cell != NULL)
+    if ((cells.GetFirst() == NULL) && warning)
     {
-      if (tmp == NULL)
-        tmp = cell;
-      else
-        cell = cell->m_next;
-    }
-    else if (warning)
-    {
-      wxString name;
-      if(cell != NULL) name = cell->ToString();
-      wxMessageBox(_("Parts of the document will not be loaded correctly!\nFound unknown XML Tag name "+ name), _("Warning"),
+      wxMessageBox(_("Parts of the document will not be loaded correctly!\nFound unknown XML Tag name "), _("Warning"),
                    wxOK | wxICON_WARNING);
       warning = false;
     }
     
-    if (node->GetAttribute(wxT("altCopy"), &altCopy))
-      cell->SetAltCopyText(altCopy);
+    if ((cells.GetLastAppended() != NULL) && node->GetAttribute(wxT("altCopy"), &altCopy))
+      cells.GetLastAppended()->SetAltCopyText(altCopy);
 
     node = node->GetNext();
   }
 
-  if (tmp != NULL)
-    return tmp;
-  return cell;
+  return cells.GetFirst();
 }
 
 /***
@@ -1006,6 +894,9 @@ MathCell* MathParser::ParseLine(wxString s, int style)
   m_highlight = false;
   MathCell* cell = NULL;
 
+  // Read the configuration once per line, not once per number.
+  ReadDisplayedDigits();
+
   wxConfigBase* config = wxConfig::Get();
   int showLength = 0;
   config->Read(wxT("showLength"), &showLength);
@@ -76,6 +76,8 @@ private:
   MathCell* ParseLimitTag(wxXmlNode* node);
   MathCell* ParseParenTag(wxXmlNode* node);
   MathCell* ParseSubSupTag(wxXmlNode* node);
+  //! Read the maximum number of digits to display from the configuration
+  void ReadDisplayedDigits();
   int m_ParserStyle;
   int m_FracStyle;
   //! The maximum number of digits of a number that is to be displayed
@@ -21,6 +21,8 @@
 
 #include "MatrCell.h"
 
+#include <algorithm>
+
 MatrCell::MatrCell() : MathCell()
 {
   m_matWidth = 0;
@@ -28,6 +30,9 @@ MatrCell::MatrCell() : MathCell()
   m_specialMatrix = false;
   m_inferenceMatrix = false;
   m_rowNames = m_colNames = false;
+  m_measuredRows = m_sizedRows = 0;
+  m_layoutFontSize = -1;
+  m_layoutScale = -1;
 }
 
 MatrCell::~MatrCell()
@@ -78,25 +83,60 @@ void MatrCell::Destroy()
   m_next = NULL;
 }
 
+size_t MatrCell::GetMemorySize()
+{
+  size_t size = sizeof(MatrCell);
+  for (unsigned int i = 0; i < m_cells.size(); i++)
+    size += GetListMemorySize(m_cells[i]);
+  return size;
+}
+
 void MatrCell::RecalculateWidths(CellParser& parser, int fontsize)
 {
   double scale = parser.GetScale();
-  for (int i = 0; i < m_matWidth*m_matHeight; i++)
+
+  // A different font size or scale changes the size of all entries.
+  if (parser.ForceUpdate() || (fontsize != m_layoutFontSize) || (scale != m_layoutScale))
   {
-    m_cells[i]->RecalculateWidthsList(parser, MAX(MC_MIN_SIZE, fontsize - 2));
+    m_layoutFontSize = fontsize;
+    m_layoutScale = scale;
+    m_measuredRows = m_sizedRows = 0;
+    m_widths.assign(m_matWidth, 0);
+    m_centers.assign(m_matHeight, 0);
+    m_drops.assign(m_matHeight, 0);
   }
-  m_widths.clear();
-  for (int i = 0; i < m_matWidth; i++)
+
+  // The rows that already have been measured keep their size. A big matrix
+  // gets only a few more rows measured per pass, the rest is left for the
+  // next pass.
+  int lastRow = m_matHeight;
+  if (parser.ProgressiveLayout() && (m_matWidth > 0))
+    lastRow = MIN(m_matHeight,
+                  m_measuredRows + MAX(1, MATRCELL_ENTRIES_PER_PASS / m_matWidth));
+
+  // The entries that are measured now might still know their size for the
+  // old font size or scale.
+  bool forceUpdate = parser.ForceUpdate();
+  parser.SetForceUpdate(true);
+  for (int j = m_measuredRows; j < lastRow; j++)
   {
-    m_widths.push_back(0);
-    for (int j = 0; j < m_matHeight; j++)
+    for (int i = 0; i < m_matWidth; i++)
     {
-      m_widths[i] = MAX(m_widths[i], m_cells[m_matWidth * j + i]->GetFullWidth(scale));
+      MathCell *entry = m_cells[m_matWidth * j + i];
+      entry->RecalculateWidthsList(parser, MAX(MC_MIN_SIZE, fontsize - 2));
+      m_widths[i] = MAX(m_widths[i], entry->GetFullWidth(scale));
     }
   }
+  parser.SetForceUpdate(forceUpdate);
+  m_measuredRows = lastRow;
+  if (m_measuredRows < m_matHeight)
+    parser.SetLayoutIncomplete(true);
+
   m_width = 0;
+  m_colStarts.clear();
   for (int i = 0; i < m_matWidth; i++)
   {
+    m_colStarts.push_back(m_width + SCALE_PX(5, scale));
     m_width += (m_widths[i] + SCALE_PX(10, scale));
   }
   if (m_width < SCALE_PX(14, scale))
@@ -108,27 +148,41 @@ void MatrCell::RecalculateSize(CellParser& parser, int fontsize)
 {
   double scale = parser.GetScale();
 
-  for (int i = 0; i < m_matWidth*m_matHeight; i++)
+  bool forceUpdate = parser.ForceUpdate();
+  parser.SetForceUpdate(true);
+  for (int i = m_sizedRows; i < m_measuredRows; i++)
   {
-    m_cells[i]->RecalculateSizeList(parser, MAX(MC_MIN_SIZE, fontsize - 2));
-  }
-  m_centers.clear();
-  m_drops.clear();
-  for (int i = 0; i < m_matHeight; i++)
-  {
-    m_centers.push_back(0);
-    m_drops.push_back(0);
     for (int j = 0; j < m_matWidth; j++)
     {
-      m_centers[i] = MAX(m_centers[i], m_cells[m_matWidth * i + j]->GetMaxCenter());
-      m_drops[i] = MAX(m_drops[i], m_cells[m_matWidth * i + j]->GetMaxDrop());
+      MathCell *entry = m_cells[m_matWidth * i + j];
+      entry->RecalculateSizeList(parser, MAX(MC_MIN_SIZE, fontsize - 2));
+      m_centers[i] = MAX(m_centers[i], entry->GetMaxCenter());
+      m_drops[i] = MAX(m_drops[i], entry->GetMaxDrop());
     }
   }
+  parser.SetForceUpdate(forceUpdate);
+  m_sizedRows = m_measuredRows;
+
   m_height = 0;
-  for (int i = 0; i < m_matHeight; i++)
+  m_rowStarts.clear();
+  for (int i = 0; i < m_sizedRows; i++)
   {
+    m_rowStarts.push_back(m_height + SCALE_PX(5, scale));
     m_height += (m_centers[i] + m_drops[i] + SCALE_PX(10, scale));
   }
+  // Rows that haven't been measured yet are assumed to be as high as the
+  // average measured row.
+  if (m_sizedRows < m_matHeight)
+  {
+    int rowHeight = fontsize + SCALE_PX(10, scale);
+    if (m_sizedRows > 0)
+      rowHeight = m_height / m_sizedRows;
+    for (int i = m_sizedRows; i < m_matHeight; i++)
+    {
+      m_rowStarts.push_back(m_height + SCALE_PX(5, scale));
+      m_height += rowHeight;
+    }
+  }
   if (m_height == 0)
     m_height = fontsize + SCALE_PX(10, scale);
   m_center = m_height / 2;
@@ -140,21 +194,34 @@ void MatrCell::Draw(CellParser& parser, wxPoint point, int fontsize)
   {
     wxDC& dc = parser.GetDC();
     double scale = parser.GetScale();
-    wxPoint mp;
-    mp.x = point.x + SCALE_PX(5, scale);
-    mp.y = point.y - m_center;
-    for (int i = 0; i < m_matWidth; i++)
+    // Only the entries that intersect the part of the worksheet that is
+    // redrawn are drawn: A matrix with many thousand entries otherwise makes
+    // every scroll step draw all of them.
+    int firstRow = 0, lastRow = m_matHeight - 1;
+    if ((parser.GetTop() != -1) && (parser.GetBottom() != -1))
+      VisibleRange(m_rowStarts,
+                   parser.GetTop() - point.y + m_center,
+                   parser.GetBottom() - point.y + m_center,
+                   &firstRow, &lastRow);
+    // Rows that haven't been measured yet are drawn as soon as they are.
+    lastRow = MIN(lastRow, m_sizedRows - 1);
+    int firstCol = 0, lastCol = m_matWidth - 1;
+    if ((parser.GetLeft() != -1) && (parser.GetRight() != -1))
+      VisibleRange(m_colStarts,
+                   parser.GetLeft() - point.x,
+                   parser.GetRight() - point.x,
+                   &firstCol, &lastCol);
+
+    for (int j = firstRow; j <= lastRow; j++)
     {
-      mp.y = point.y - m_center + SCALE_PX(5, scale);
-      for (int j = 0; j < m_matHeight; j++)
+      for (int i = firstCol; i <= lastCol; i++)
       {
-        mp.y += m_centers[j];
-        wxPoint mp1(mp);
-        mp1.x = mp.x + (m_widths[i] - m_cells[j * m_matWidth + i]->GetFullWidth(scale)) / 2;
+        wxPoint mp1;
+        mp1.x = point.x + m_colStarts[i] +
+          (m_widths[i] - m_cells[j * m_matWidth + i]->GetFullWidth(scale)) / 2;
+        mp1.y = point.y - m_center + m_rowStarts[j] + m_centers[j];
         m_cells[j*m_matWidth + i]->DrawList(parser, mp1, MAX(MC_MIN_SIZE, fontsize - 2));
-        mp.y += (m_drops[j] + SCALE_PX(10, scale));
       }
-      mp.x += (m_widths[i] + SCALE_PX(10, scale));
     }
     SetPen(parser);
     if (m_specialMatrix)
@@ -283,9 +350,22 @@ void MatrCell::SelectInner(wxRect& rect, MathCell** first, MathCell** last)
 {
   *first = NULL;
   *last = NULL;
-  for (int i = 0; i < m_matHeight; i++)
+  // Entries that haven't been drawn since the last recalculation don't know
+  // their position => only look at the entries the rectangle covers.
+  int firstRow = 0, lastRow = m_matHeight - 1;
+  int firstCol = 0, lastCol = m_matWidth - 1;
+  VisibleRange(m_rowStarts,
+               rect.GetTop() - m_currentPoint.y + m_center,
+               rect.GetBottom() - m_currentPoint.y + m_center,
+               &firstRow, &lastRow);
+  VisibleRange(m_colStarts,
+               rect.GetLeft() - m_currentPoint.x,
+               rect.GetRight() - m_currentPoint.x,
+               &firstCol, &lastCol);
+  lastRow = MIN(lastRow, m_sizedRows - 1);
+  for (int i = firstRow; i <= lastRow; i++)
   {
-    for (int j = 0; j < m_matWidth; j++)
+    for (int j = firstCol; j <= lastCol; j++)
     {
       if (m_cells[i*m_matWidth + j]->ContainsRect(rect))
         m_cells[i*m_matWidth + j]->SelectRect(rect, first, last);
@@ -297,3 +377,14 @@ void MatrCell::SelectInner(wxRect& rect, MathCell** first, MathCell** last)
     *last = this;
   }
 }
+
+void MatrCell::VisibleRange(const vector<int> &starts, int from, int to,
+                            int *first, int *last)
+{
+  // The row or column that contains "from" is the last one that starts
+  // before it.
+  *first = upper_bound(starts.begin(), starts.end(), from) - starts.begin() - 1;
+  if (*first < 0)
+    *first = 0;
+  *last = upper_bound(starts.begin(), starts.end(), to) - starts.begin() - 1;
+}
@@ -28,12 +28,20 @@
 
 using namespace std;
 
+/*! How many entries of a matrix are measured in one layout pass
+
+  Bigger matrices are measured a few rows at a time if the CellParser allows
+  for a progressive layout.
+ */
+#define MATRCELL_ENTRIES_PER_PASS 2000
+
 class MatrCell : public MathCell
 {
 public:
   MatrCell();
   ~MatrCell();
   void Destroy();
+  size_t GetMemorySize();
   MathCell* Copy();
   void RecalculateSize(CellParser& parser, int fontsize);
   void RecalculateWidths(CellParser& parser, int fontsize);
@@ -68,6 +76,27 @@ protected:
   vector<int> m_widths;
   vector<int> m_drops;
   vector<int> m_centers;
+  //! The offset of the left edge of each column from the left of the matrix
+  vector<int> m_colStarts;
+  //! The offset of the top edge of each row from the top of the matrix
+  vector<int> m_rowStarts;
+  //! The number of rows whose entries have been measured by RecalculateWidths()
+  int m_measuredRows;
+  //! The number of rows whose entries have been measured by RecalculateSize()
+  int m_sizedRows;
+  //! The font size and scale the measured rows have been measured for
+  int m_layoutFontSize;
+  double m_layoutScale;
+private:
+  /*! Find the rows or columns that overlap the interval [from, to]
+
+    \param starts The sorted offsets of the rows or columns
+    \param first Is set to the first row or column that is visible
+    \param last  Is set to the last row or column that is visible. If
+                  last < first nothing is visible.
+   */
+  static void VisibleRange(const vector<int> &starts, int from, int to,
+                           int *first, int *last);
 };
 
 #endif // MATRCELL_H
@@ -93,6 +93,14 @@ void ParenCell::Destroy()
   m_next = NULL;
 }
 
+size_t ParenCell::GetMemorySize()
+{
+  return sizeof(ParenCell) +
+    GetListMemorySize(m_innerCell) +
+    GetListMemorySize(m_open) +
+    GetListMemorySize(m_close);
+}
+
 void ParenCell::SetInner(MathCell *inner, int type)
 {
   if (inner == NULL)
@@ -144,7 +152,7 @@ void ParenCell::RecalculateWidths(CellParser& parser, int fontsize)
 			 m_bigParenType == 0 ?
 			 parser.GetTeXCMRI() :
 			 parser.GetTeXCMEX()));
-      dc.GetTextExtent(m_bigParenType == 0 ? wxT("(") :
+      parser.GetTextExtent(m_bigParenType == 0 ? wxT("(") :
                        m_bigParenType == 1 ? wxT(PAREN_OPEN) :
 		       wxT(PAREN_OPEN_TOP),
                        &m_signWidth, &m_signSize);
@@ -167,7 +175,7 @@ void ParenCell::RecalculateWidths(CellParser& parser, int fontsize)
                             m_bigParenType == 0 ?
                             parser.GetTeXCMRI() :
                             parser.GetTeXCMEX()));
-          dc.GetTextExtent(m_bigParenType == 0 ? wxT("(") :
+          parser.GetTextExtent(m_bigParenType == 0 ? wxT("(") :
                            m_bigParenType == 1 ? wxT(PAREN_OPEN) :
                            wxT(PAREN_OPEN_TOP),
                            &m_signWidth, &m_signSize);
@@ -185,7 +193,7 @@ void ParenCell::RecalculateWidths(CellParser& parser, int fontsize)
                         m_bigParenType < 1 ?
 			parser.GetTeXCMRI() :
 			parser.GetTeXCMEX()));
-      dc.GetTextExtent(wxT(PAREN_OPEN), &m_signWidth, &m_signSize);
+      parser.GetTextExtent(wxT(PAREN_OPEN), &m_signWidth, &m_signSize);
     }
 
     m_signTop = m_signSize / 5;
@@ -201,7 +209,7 @@ void ParenCell::RecalculateWidths(CellParser& parser, int fontsize)
                       parser.IsBold(TS_DEFAULT),
                       parser.IsUnderlined(TS_DEFAULT),
                       parser.GetSymbolFontName()));
-    dc.GetTextExtent(PAREN_LEFT_TOP, &m_charWidth, &m_charHeight);
+    parser.GetTextExtent(PAREN_LEFT_TOP, &m_charWidth, &m_charHeight);
     if(m_charHeight < 2)
       m_charHeight = 2;
     m_width = m_innerCell->GetFullWidth(scale) + 2*m_charWidth;
@@ -229,7 +237,7 @@ void ParenCell::RecalculateSize(CellParser& parser, int fontsize)
     dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
                       wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
                       parser.GetFontName()));
-    dc.GetTextExtent(wxT("("), &m_charWidth1, &m_charHeight1);
+    parser.GetTextExtent(wxT("("), &m_charWidth1, &m_charHeight1);
     if(m_charHeight1 < 2)
       m_charHeight1 = 2;
   }
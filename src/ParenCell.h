@@ -31,6 +31,7 @@ public:
   ParenCell();
   ~ParenCell();
   void Destroy();
+  size_t GetMemorySize();
   MathCell* Copy();
   void SetInner(MathCell *inner, int style);
   void SetPrint(bool print)
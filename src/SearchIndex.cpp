@@ -0,0 +1,182 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "SearchIndex.h"
+#include "EditorCell.h"
+
+#include <wx/stopwatch.h>
+#include <algorithm>
+#include <iterator>
+
+std::map<SearchIndex::Gram, SearchIndex::CellList> SearchIndex::m_cells;
+std::map<EditorCell *, std::vector<SearchIndex::Gram> > SearchIndex::m_grams;
+std::set<EditorCell *> SearchIndex::m_changed;
+
+void SearchIndex::TextChanged(EditorCell *cell)
+{
+  m_changed.insert(cell);
+}
+
+void SearchIndex::Remove(EditorCell *cell)
+{
+  m_changed.erase(cell);
+  Unindex(cell);
+}
+
+void SearchIndex::Unindex(EditorCell *cell)
+{
+  std::map<EditorCell *, std::vector<Gram> >::iterator grams = m_grams.find(cell);
+  if (grams == m_grams.end())
+    return;
+
+  for (std::vector<Gram>::iterator it = grams->second.begin(); it != grams->second.end(); ++it)
+  {
+    std::map<Gram, CellList>::iterator cells = m_cells.find(*it);
+    if (cells == m_cells.end())
+      continue;
+    CellList::iterator pos = std::lower_bound(cells->second.begin(), cells->second.end(), cell);
+    if ((pos != cells->second.end()) && (*pos == cell))
+      cells->second.erase(pos);
+    if (cells->second.empty())
+      m_cells.erase(cells);
+  }
+  m_grams.erase(grams);
+}
+
+void SearchIndex::Grams(const wxString &text, std::vector<Gram> &grams)
+{
+  grams.clear();
+  if (text.Length() < SEARCHINDEX_GRAM_LENGTH)
+    return;
+
+  wxString lower = text.Lower();
+  grams.reserve(lower.Length());
+  Gram gram = 0;
+  size_t length = 0;
+  for (wxString::const_iterator it = lower.begin(); it != lower.end(); ++it)
+  {
+    // 21 bits are enough for every unicode character.
+    gram = ((gram << 21) | (((wxChar) *it) & 0x1FFFFF)) & ((((Gram) 1) << 63) - 1);
+    if (++length >= SEARCHINDEX_GRAM_LENGTH)
+      grams.push_back(gram);
+  }
+  std::sort(grams.begin(), grams.end());
+  grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+}
+
+bool SearchIndex::Update(long maxTime)
+{
+  if (m_changed.empty())
+    return false;
+
+  // Loading a file changes the text of thousands of cells: Collect the changes
+  // and merge them into the lists of cells in one step.
+  wxStopWatch stopwatch;
+  std::vector<std::pair<Gram, EditorCell *> > added;
+  while (!m_changed.empty() && ((maxTime < 0) || (stopwatch.Time() < maxTime)))
+  {
+    EditorCell *cell = *m_changed.begin();
+    m_changed.erase(m_changed.begin());
+    Unindex(cell);
+    std::vector<Gram> grams;
+    Grams(cell->GetValue(), grams);
+    if (grams.empty())
+      continue;
+    for (std::vector<Gram>::iterator it = grams.begin(); it != grams.end(); ++it)
+      added.push_back(std::make_pair(*it, cell));
+    m_grams[cell].swap(grams);
+  }
+
+  std::sort(added.begin(), added.end());
+  size_t i = 0;
+  while (i < added.size())
+  {
+    Gram gram = added[i].first;
+    CellList newCells;
+    while ((i < added.size()) && (added[i].first == gram))
+      newCells.push_back(added[i++].second);
+
+    CellList &cells = m_cells[gram];
+    if (newCells.size() == 1)
+      cells.insert(std::lower_bound(cells.begin(), cells.end(), newCells[0]), newCells[0]);
+    else
+    {
+      CellList merged;
+      merged.reserve(cells.size() + newCells.size());
+      std::merge(cells.begin(), cells.end(), newCells.begin(), newCells.end(),
+                 std::back_inserter(merged));
+      cells.swap(merged);
+    }
+  }
+  return !m_changed.empty();
+}
+
+bool SearchIndex::Candidates(const wxString &str, std::vector<EditorCell *> &cells)
+{
+  cells.clear();
+  if (str.Length() < SEARCHINDEX_GRAM_LENGTH)
+    return false;
+
+  Update();
+  std::vector<Gram> grams;
+  Grams(str, grams);
+
+  // Start with the rarest sequence so the intersection stays small.
+  std::vector<const CellList *> lists;
+  for (std::vector<Gram>::iterator it = grams.begin(); it != grams.end(); ++it)
+  {
+    std::map<Gram, CellList>::iterator list = m_cells.find(*it);
+    if (list == m_cells.end())
+      return true;
+    lists.push_back(&list->second);
+  }
+  const CellList *rarest = lists[0];
+  for (size_t i = 1; i < lists.size(); i++)
+    if (lists[i]->size() < rarest->size())
+      rarest = lists[i];
+
+  cells = *rarest;
+  for (size_t i = 0; (i < lists.size()) && !cells.empty(); i++)
+  {
+    if (lists[i] == rarest)
+      continue;
+    CellList intersection;
+    std::set_intersection(cells.begin(), cells.end(), lists[i]->begin(), lists[i]->end(),
+                          std::back_inserter(intersection));
+    cells.swap(intersection);
+  }
+  return true;
+}
+
+bool SearchIndex::MightContain(EditorCell *cell, const wxString &str)
+{
+  if (str.Length() < SEARCHINDEX_GRAM_LENGTH)
+    return true;
+
+  Update();
+  std::map<EditorCell *, std::vector<Gram> >::iterator cellGrams = m_grams.find(cell);
+  if (cellGrams == m_grams.end())
+    return false;
+
+  std::vector<Gram> grams;
+  Grams(str, grams);
+  return std::includes(cellGrams->second.begin(), cellGrams->second.end(),
+                       grams.begin(), grams.end());
+}
@@ -0,0 +1,105 @@
+// -*- mode: c++; c-file-style: "linux"; c-basic-offset: 2; indent-tabs-mode: nil -*-
+//
+//  Copyright (C) 2015 Gunter Königsmann <wxMaxima@physikbuch.de>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+/*! \file
+
+  The index find and replace use to skip cells that cannot contain a string.
+ */
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <wx/wx.h>
+#include <map>
+#include <set>
+#include <vector>
+
+class EditorCell;
+
+//! The length of the character sequences SearchIndex indexes
+#define SEARCHINDEX_GRAM_LENGTH 3
+//! The number of milliseconds indexing may block the GUI at once in the idle loop
+#define SEARCHINDEX_BATCH_TIMEOUT 30
+
+/*! An index of the 3-character sequences the text of every EditorCell contains
+
+  A string can only be contained in a cell that contains all 3-character
+  sequences of the string. Looking these sequences up in the index therefore
+  tells which cells have to be searched, and find, replace all and the
+  highlighting of the matches don't need to scan the text of all other cells.
+
+  The index ignores the case: A cell it returns might contain the string, a
+  cell it doesn't return certainly doesn't. Strings shorter than 3 characters
+  cannot be looked up.
+
+  Every EditorCell reports when its text changes and when it is deleted. The
+  changed cells are indexed again in the idle loop or on the next lookup, so
+  typing only costs an insertion into a set. Cells that aren't part of the worksheet (for example
+  the ones in the undo buffer) are indexed, too: The caller has to walk the
+  worksheet and test the cells it finds there. All of this happens in the GUI
+  thread, only.
+ */
+class SearchIndex
+{
+public:
+  //! Re-index the text of this cell before the next lookup
+  static void TextChanged(EditorCell *cell);
+  //! Forget a cell that is being deleted
+  static void Remove(EditorCell *cell);
+  /*! Find all cells that might contain a string
+
+    \param str The string to search for
+    \param cells Is set to the cells that might contain str, sorted by their
+                 address so they can be tested for with std::binary_search
+    \return false, if str is too short to be looked up: Every cell might
+            contain it, then.
+   */
+  static bool Candidates(const wxString &str, std::vector<EditorCell *> &cells);
+  //! Might the text of this cell contain str?
+  static bool MightContain(EditorCell *cell, const wxString &str);
+  /*! Index the cells whose text has changed since the last lookup
+
+    Lookups do this, too. Doing it in the idle loop makes the first search in a
+    file that has just been opened fast.
+
+    \param maxTime The number of milliseconds after which to stop, or -1
+    
+eturn true, if there are changed cells left.
+   */
+  static bool Update(long maxTime = -1);
+
+private:
+  //! A sequence of SEARCHINDEX_GRAM_LENGTH lower-case characters
+  typedef wxUint64 Gram;
+  //! A list of cells, sorted by their address
+  typedef std::vector<EditorCell *> CellList;
+  //! The sorted list of all distinct sequences in the lower-case version of text
+  static void Grams(const wxString &text, std::vector<Gram> &grams);
+  //! Remove a cell from the lists of cells
+  static void Unindex(EditorCell *cell);
+  //! For every sequence the cells that contain it
+  static std::map<Gram, CellList> m_cells;
+  //! For every cell the sequences it has been indexed with
+  static std::map<EditorCell *, std::vector<Gram> > m_grams;
+  //! The cells whose text has changed since the last lookup
+  static std::set<EditorCell *> m_changed;
+};
+
+#endif // SEARCHINDEX_H
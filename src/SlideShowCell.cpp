@@ -107,6 +107,9 @@ MathCell* SlideShow::Copy()
   SlideShow* tmp = new SlideShow;
   CopyData(this, tmp);
 
+  // This doesn't duplicate the image data: The compressed image and the
+  // scaled bitmap are reference-counted by wxWidgets and are shared between
+  // both copies until one of them is changed.
   for(int i=0;i<m_images.size();i++)
   {
     Image *image = new Image(*m_images[i]);
@@ -288,6 +291,14 @@ void SlideShow::ClearCache()
       m_images[i]->ClearCache();
 }
 
+size_t SlideShow::GetDataSize()
+{
+  size_t size = 0;
+  for (int i=0; i<m_size; i++)
+    size += m_images[i]->GetCompressedImage().GetDataLen();
+  return size;
+}
+
 bool SlideShow::CopyToClipboard()
 {
   if (wxTheClipboard->Open())
@@ -50,6 +50,8 @@ public:
     of the screen; The bitmaps will be re-generated when needed.
    */
   virtual void ClearCache();
+  //! The size of all compressed images
+  virtual size_t GetDataSize();
   void Destroy();
   void LoadImages(wxArrayString images);
   MathCell* Copy();
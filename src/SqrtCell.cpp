@@ -70,6 +70,14 @@ void SqrtCell::Destroy()
   m_next = NULL;
 }
 
+size_t SqrtCell::GetMemorySize()
+{
+  return sizeof(SqrtCell) +
+    GetListMemorySize(m_innerCell) +
+    GetListMemorySize(m_open) +
+    GetListMemorySize(m_close);
+}
+
 void SqrtCell::SetInner(MathCell *inner)
 {
   if (inner == NULL)
@@ -97,7 +105,7 @@ void SqrtCell::RecalculateWidths(CellParser& parser, int fontsize)
     int fontsize1 = (int)(SIGN_FONT_SCALE*scale*fontsize*m_signFontScale + 0.5);
 
     dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false, parser.GetTeXCMEX()));
-    dc.GetTextExtent(wxT("s"), &m_signWidth, &m_signSize);
+    parser.GetTextExtent(wxT("s"), &m_signWidth, &m_signSize);
     m_signTop = m_signSize / 5;
     m_width = m_innerCell->GetFullWidth(scale) + m_signWidth;
 
@@ -126,7 +134,7 @@ void SqrtCell::RecalculateWidths(CellParser& parser, int fontsize)
 
     fontsize1 = (int)(SIGN_FONT_SCALE*scale*fontsize*m_signFontScale + 0.5);
     dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false, parser.GetTeXCMEX()));
-    dc.GetTextExtent(wxT("s"), &m_signWidth, &m_signSize);
+    parser.GetTextExtent(wxT("s"), &m_signWidth, &m_signSize);
     m_signTop = m_signSize / 5;
     m_width = m_innerCell->GetFullWidth(scale) + m_signWidth;
   }
@@ -31,6 +31,7 @@ public:
   ~SqrtCell();
   MathCell* Copy();
   void Destroy();
+  size_t GetMemorySize();
   void SetInner(MathCell *inner);
   void SelectInner(wxRect& rect, MathCell** first, MathCell** last);
   void RecalculateSize(CellParser& parser, int fontsize);
@@ -69,6 +69,13 @@ void SubCell::Destroy()
   m_next = NULL;
 }
 
+size_t SubCell::GetMemorySize()
+{
+  return sizeof(SubCell) +
+    GetListMemorySize(m_baseCell) +
+    GetListMemorySize(m_indexCell);
+}
+
 void SubCell::SetIndex(MathCell *index)
 {
   if (index == NULL)
@@ -129,8 +136,8 @@ void SubCell::Draw(CellParser& parser, wxPoint point, int fontsize)
 
 wxString SubCell::ToString()
 {
-  if (m_altCopyText != wxEmptyString) {
-    return m_altCopyText;
+  if (m_altCopyText != NULL) {
+    return *m_altCopyText;
   }
 
   wxString s;
@@ -151,12 +158,12 @@ wxString SubCell::ToTeX()
 
 wxString SubCell::ToXML()
 {
-  if (m_altCopyText == wxEmptyString)
+  if (m_altCopyText == NULL)
   {
     return _T("<i><r>") + m_baseCell->ListToXML() + _T("</r><r>") +
       m_indexCell->ListToXML() + _T("</r></i>");
   }
-  return _T("<i altCopy=\"" + m_altCopyText + "\"><r>") + m_baseCell->ListToXML() + _T("</r><r>") +
+  return _T("<i altCopy=\"" + *m_altCopyText + "\"><r>") + m_baseCell->ListToXML() + _T("</r><r>") +
       m_indexCell->ListToXML() + _T("</r></i>");
 }
 
@@ -79,6 +79,14 @@ void SubSupCell::Destroy()
   m_next = NULL;
 }
 
+size_t SubSupCell::GetMemorySize()
+{
+  return sizeof(SubSupCell) +
+    GetListMemorySize(m_baseCell) +
+    GetListMemorySize(m_indexCell) +
+    GetListMemorySize(m_exptCell);
+}
+
 void SubSupCell::SetIndex(MathCell *index)
 {
   if (index == NULL)
@@ -31,6 +31,7 @@ public:
   ~SubSupCell();
   MathCell* Copy();
   void Destroy();
+  size_t GetMemorySize();
   void SetBase(MathCell *base);
   void SetIndex(MathCell *index);
   void SetExponent(MathCell *expt);
@@ -86,6 +86,14 @@ void SumCell::Destroy()
   m_over = NULL;
 }
 
+size_t SumCell::GetMemorySize()
+{
+  return sizeof(SumCell) +
+    GetListMemorySize(m_base) +
+    GetListMemorySize(m_under) +
+    GetListMemorySize(m_over);
+}
+
 void SumCell::SetOver(MathCell* over)
 {
   if (over == NULL)
@@ -134,7 +142,7 @@ void SumCell::RecalculateWidths(CellParser& parser, int fontsize)
     dc.SetFont(wxFont(fontsize1, wxFONTFAMILY_MODERN,
     		          wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL, false,
                       parser.GetTeXCMEX()));
-    dc.GetTextExtent(m_sumStyle == SM_SUM ? wxT(SUM_SIGN) : wxT(PROD_SIGN), &m_signWidth, &m_signSize);
+    parser.GetTextExtent(m_sumStyle == SM_SUM ? wxT(SUM_SIGN) : wxT(PROD_SIGN), &m_signWidth, &m_signSize);
     m_signWCenter = m_signWidth / 2;
     m_signTop = (2* m_signSize) / 5;
     m_signSize = (2 * m_signSize) / 5;
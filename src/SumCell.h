@@ -35,6 +35,7 @@ public:
   SumCell();
   ~SumCell();
   void Destroy();
+  size_t GetMemorySize();
   MathCell* Copy();
   void RecalculateSize(CellParser& parser, int fontsize);
   void RecalculateWidths(CellParser& parser, int fontsize);
@@ -23,6 +23,8 @@
 #include "Setup.h"
 #include "wx/config.h"
 
+std::map<wxString, wxSize> TextCell::m_sizeCache;
+
 TextCell::TextCell() : MathCell()
 {
   m_text = wxEmptyString;
@@ -72,6 +74,12 @@ void TextCell::Destroy()
   m_next = NULL;
 }
 
+size_t TextCell::GetMemorySize()
+{
+  return sizeof(TextCell) +
+    (m_text.Length() + m_altText.Length() + m_altJsText.Length()) * sizeof(wxChar);
+}
+
 wxString TextCell::LabelWidthText()
 {
   wxString result;
@@ -96,20 +104,20 @@ void TextCell::RecalculateWidths(CellParser& parser, int fontsize)
 
     wxDC& dc = parser.GetDC();
     double scale = parser.GetScale();
-    SetFont(parser, fontsize);
 
     // Labels and prompts are fixed width - adjust font size so that
     // they fit in
     if ((m_textStyle == TS_LABEL) || (m_textStyle == TS_USERLABEL) || (m_textStyle == TS_MAIN_PROMPT)) {
+      SetFont(parser, fontsize);
 	  // Check for output annotations (/R/ for CRE and /T/ for Taylor expressions)
       if (m_text.Right(2) != wxT("/ "))
-        dc.GetTextExtent(wxT("(\%o")+LabelWidthText()+wxT(")"), &m_width, &m_height);
+        parser.GetTextExtent(wxT("(\%o")+LabelWidthText()+wxT(")"), &m_width, &m_height);
       else
-        dc.GetTextExtent(wxT("(\%o")+LabelWidthText()+wxT(")/R/"), &m_width, &m_height);
+        parser.GetTextExtent(wxT("(\%o")+LabelWidthText()+wxT(")/R/"), &m_width, &m_height);
       m_fontSizeLabel = m_fontSize;
       wxASSERT_MSG((m_width>0)||(m_text==wxEmptyString),_("The letter \"X\" is of width zero. Installing http://www.math.union.edu/~dpvc/jsmath/download/jsMath-fonts.html and checking \"Use JSmath fonts\" in the configuration dialogue should fix it."));
       if(m_width < 1) m_width = 10;
-      dc.GetTextExtent(m_text, &m_labelWidth, &m_labelHeight);
+      parser.GetTextExtent(m_text, &m_labelWidth, &m_labelHeight);
       wxASSERT_MSG((m_labelWidth>0)||(m_text==wxEmptyString),_("Seems like something is broken with the maths font. Installing http://www.math.union.edu/~dpvc/jsmath/download/jsMath-fonts.html and checking \"Use JSmath fonts\" in the configuration dialogue should fix it."));
       while ((m_labelWidth >= m_width)&&(m_fontSizeLabel > 2)) {
         int fontsize1 = (int) (((double) --m_fontSizeLabel) * scale + 0.5);
@@ -119,36 +127,57 @@ void TextCell::RecalculateWidths(CellParser& parser, int fontsize)
               false, //parser.IsUnderlined(m_textStyle),
               parser.GetFontName(m_textStyle),
               parser.GetFontEncoding()));
-        dc.GetTextExtent(m_text, &m_labelWidth, &m_labelHeight);
+        parser.GetTextExtent(m_text, &m_labelWidth, &m_labelHeight);
       }
     }
 
-    /// Check if we are using jsMath and have jsMath character
-    else if (m_altJs && parser.CheckTeXFonts())
-    {
-      dc.GetTextExtent(m_altJsText, &m_width, &m_height);
-
-      if (m_texFontname == wxT("jsMath-cmsy10"))
-        m_height = m_height / 2;
-    }
-
-    /// We are using a special symbol
-    else if (m_alt)
-    {
-      dc.GetTextExtent(m_altText, &m_width, &m_height);
-    }
-
-    /// Empty string has height of X
-    else if (m_text == wxEmptyString)
+    /// All other cells with the same text and style have the same size
+    /// => Only the first of them has to be measured.
+    else
     {
-      dc.GetTextExtent(wxT("X"), &m_width, &m_height);
-      m_width = 0;
+      wxString key = SizeCacheKey(parser, fontsize);
+      std::map<wxString, wxSize>::iterator cached = m_sizeCache.find(key);
+      if (cached != m_sizeCache.end())
+      {
+        m_width = cached->second.x;
+        m_height = cached->second.y;
+      }
+      else
+      {
+        SetFont(parser, fontsize);
+
+        /// Check if we are using jsMath and have jsMath character
+        if (m_altJs && parser.CheckTeXFonts())
+        {
+          parser.GetTextExtent(m_altJsText, &m_width, &m_height);
+
+          if (m_texFontname == wxT("jsMath-cmsy10"))
+            m_height = m_height / 2;
+        }
+
+        /// We are using a special symbol
+        else if (m_alt)
+        {
+          parser.GetTextExtent(m_altText, &m_width, &m_height);
+        }
+
+        /// Empty string has height of X
+        else if (m_text == wxEmptyString)
+        {
+          parser.GetTextExtent(wxT("X"), &m_width, &m_height);
+          m_width = 0;
+        }
+
+        /// This is the default.
+        else
+          parser.GetTextExtent(m_text, &m_width, &m_height);
+
+        if (m_sizeCache.size() >= TEXTCELL_SIZECACHE_MAX)
+          m_sizeCache.clear();
+        m_sizeCache[key] = wxSize(m_width, m_height);
+      }
     }
 
-    /// This is the default.
-    else
-      dc.GetTextExtent(m_text, &m_width, &m_height);
-
     m_width = m_width + 2 * SCALE_PX(MC_TEXT_PADDING, scale);
     m_height = m_height + 2 * SCALE_PX(MC_TEXT_PADDING, scale);
 
@@ -164,6 +193,16 @@ void TextCell::RecalculateWidths(CellParser& parser, int fontsize)
   ResetData();
 }
 
+wxString TextCell::SizeCacheKey(CellParser& parser, int fontsize)
+{
+  return wxString::Format(wxT("%i:%i:%i:%i:%i:%i:"),
+                          m_textStyle, fontsize,
+                          (int) (parser.GetScale() * 1000),
+                          parser.GetDC().GetPPI().y,
+                          parser.CheckTeXFonts(),
+                          parser.CheckKeepPercent()) + m_text;
+}
+
 void TextCell::Draw(CellParser& parser, wxPoint point, int fontsize)
 {
   double scale = parser.GetScale();
@@ -328,8 +367,8 @@ bool TextCell::IsOperator()
 wxString TextCell::ToString()
 {
   wxString text;
-  if (m_altCopyText != wxEmptyString)
-    text = m_altCopyText;
+  if (m_altCopyText != NULL)
+    text = *m_altCopyText;
   else {
     text = m_text;
 #if wxUSE_UNICODE
@@ -23,6 +23,10 @@
 #define TEXTCELL_H
 
 #include "MathCell.h"
+#include <map>
+
+//! The maximum number of text sizes TextCell remembers
+#define TEXTCELL_SIZECACHE_MAX 20000
 
 class TextCell : public MathCell
 {
@@ -32,6 +36,7 @@ public:
   ~TextCell();
   MathCell* Copy();
   void Destroy();
+  size_t GetMemorySize();
   void SetValue(wxString text);
   void RecalculateWidths(CellParser& parser, int fontsize);
   void Draw(CellParser& parser, wxPoint point, int fontsize);
@@ -52,6 +57,8 @@ public:
   wxString GetSymbolSymbol(bool keepPercent);
 #endif
   bool IsShortNum();
+  //! Forget the sizes of all texts, for example because the fonts have changed
+  static void ClearSizeCache() { m_sizeCache.clear(); }
 protected:
   void SetAltText(CellParser& parser);
   wxString m_text;
@@ -66,6 +73,15 @@ protected:
 private:
   //! Produces a text sample that determines the label width
   wxString LabelWidthText();
+  //! Describes everything the size of this cell depends on
+  wxString SizeCacheKey(CellParser& parser, int fontsize);
+  /*! The sizes of all texts that have been measured so far
+
+    Long outputs tend to contain the same numbers, variable names and operators
+    over and over again. All cells with the same text, style and font size share
+    one entry in this table.
+  */
+  static std::map<wxString, wxSize> m_sizeCache;
 
 };
 
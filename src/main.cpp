@@ -28,6 +28,7 @@
 #include <wx/cmdline.h>
 #include <wx/fileconf.h>
 #include "Dirstructure.h"
+#include "Benchmark.h"
 #include <iostream>
 
 #include "wxMaxima.h"
@@ -46,11 +47,41 @@
 
 IMPLEMENT_APP(MyApp)
 
+bool MyApp::m_startupProfile = false;
+wxStopWatch MyApp::m_startupTime;
+long MyApp::m_lastStartupPhase = 0;
+
+void MyApp::StartupPhase(wxString phase)
+{
+  if (!m_startupProfile)
+    return;
+
+  long now = m_startupTime.Time();
+  std::cerr << "startup: " << phase.mb_str() << ": "
+            << now - m_lastStartupPhase << " ms (" << now << " ms total)\n";
+  m_lastStartupPhase = now;
+}
+
+void MyApp::StartupFinished()
+{
+  StartupPhase(wxT("first prompt"));
+  // Restarting maxima shouldn't produce a new report.
+  m_startupProfile = false;
+}
+
 void MyApp::Cleanup_Static()
 {
   std::cout <<"Cleanup\n";
   if(m_frame)
     m_frame->CleanUp();
+  GlyphMetrics::ClearCache();
+}
+
+int MyApp::OnExit()
+{
+  // Cleanup_Static() isn't called on a regular exit.
+  GlyphMetrics::ClearCache();
+  return wxApp::OnExit();
 }
 
 bool MyApp::OnInit()
@@ -83,6 +114,8 @@ bool MyApp::OnInit()
       { wxCMD_LINE_SWITCH, "h", "help", "show this help message", wxCMD_LINE_VAL_NONE},
       { wxCMD_LINE_OPTION, "o", "open", "open a file" },
       { wxCMD_LINE_SWITCH, "b", "batch","run the file and exit afterwards. Halts on questions and stops on errors." },
+      { wxCMD_LINE_SWITCH, "", "startup-profile","print the time each phase of the startup takes" },
+      { wxCMD_LINE_SWITCH, "", "benchmark","measure how wxMaxima copes with huge outputs and exit" },
 #if defined __WXMSW__
       { wxCMD_LINE_OPTION, "f", "ini", "open an input file" },
 #endif
@@ -92,6 +125,8 @@ bool MyApp::OnInit()
 
   cmdLineParser.SetDesc(cmdLineDesc);
   cmdLineParser.Parse();
+  m_startupProfile = cmdLineParser.Found(wxT("startup-profile"));
+  StartupPhase(wxT("locale and command line"));
   wxString ini, file;
 #if defined __WXMSW__
   if (cmdLineParser.Found(wxT("f"),&ini))
@@ -121,6 +156,7 @@ bool MyApp::OnInit()
   
   m_locale.AddCatalog(wxT("wxMaxima"));
   m_locale.AddCatalog(wxT("wxMaxima-wxstd"));
+  StartupPhase(wxT("configuration and translations"));
 
 #if defined __WXMAC__
   wxString path;
@@ -157,6 +193,12 @@ bool MyApp::OnInit()
       wxExit();
     }
 
+  if (cmdLineParser.Found(wxT("benchmark")))
+    {
+      Benchmark::Run();
+      wxExit();
+    }
+
   if (cmdLineParser.Found(wxT("b")))
   {
     batchmode = true;
@@ -224,6 +266,7 @@ void MyApp::NewWindow(wxString file,bool batchmode)
 
   m_frame = new wxMaxima((wxFrame *)NULL, -1, _("wxMaxima"),
                                  wxPoint(x, y), wxSize(w, h));
+  StartupPhase(wxT("main window"));
 
   m_frame->Move(wxPoint(x, y));
   m_frame->SetSize(wxSize(w, h));
@@ -243,8 +286,11 @@ void MyApp::NewWindow(wxString file,bool batchmode)
 
   SetTopWindow(m_frame);
   m_frame->Show(true);
+  StartupPhase(wxT("show main window"));
   m_frame->InitSession();
+  StartupPhase(wxT("start maxima"));
   m_frame->ShowTip(false);
+  StartupPhase(wxT("tip of the day"));
 }
 
 #if defined (__WXMAC__)
@@ -41,6 +41,7 @@
 #include "MathPrintout.h"
 #include "MyTipProvider.h"
 #include "EditorCell.h"
+#include "SearchIndex.h"
 #include "SlideShowCell.h"
 #include "PlotFormatWiz.h"
 #include "Dirstructure.h"
@@ -135,6 +136,9 @@ wxMaxima::wxMaxima(wxWindow *parent, int id, const wxString title,
 
   m_client = NULL;
   m_server = NULL;
+  m_standbyProcess = NULL;
+  m_standbyPid = -1;
+  m_standbyClient = NULL;
 
   config->Read(wxT("lastPath"), &m_lastPath);
   m_lastPrompt = wxEmptyString;
@@ -284,8 +288,10 @@ void wxMaxima::FirstOutput(wxString s)
 
   m_lastPrompt = wxT("(%i1) ");
   
+  MyApp::StartupPhase(wxT("maxima banner"));
   /// READ FUNCTIONS FOR AUTOCOMPLETION
   m_console->LoadSymbols(dirstructure.AutocompleteFile());
+  MyApp::StartupPhase(wxT("autocompletion symbols"));
 
   m_console->SetFocus();
 }
@@ -433,7 +439,7 @@ void wxMaxima::DoRawConsoleAppend(wxString s, int type)
   {
     wxStringTokenizer tokens(s, wxT("\n"));
     int count = 0;
-    MathCell *tmp = NULL, *lst = NULL;
+    CellListBuilder lines;
     while (tokens.HasMoreTokens())
     {
       TextCell* cell = new TextCell(tokens.GetNextToken());
@@ -443,17 +449,13 @@ void wxMaxima::DoRawConsoleAppend(wxString s, int type)
       if (tokens.HasMoreTokens())
         cell->SetSkip(false);
 
-      if (lst == NULL)
-        tmp = lst = cell;
-      else {
-        lst->AppendCell(cell);
+      if (lines.GetFirst() != NULL)
         cell->ForceBreakLine(true);
-        lst = cell;
-      }
+      lines.Append(cell);
 
       count++;
     }
-    m_console->InsertLine(tmp, true);
+    m_console->InsertLine(lines.GetFirst(), true);
   }
 
   if(scrollToCaret) m_console -> ScrollToCaret();
@@ -522,7 +524,10 @@ void wxMaxima::SendMaxima(wxString s, bool addToHistory)
 
   /// Add this command to History
   if (addToHistory)
+  {
     AddToHistory(s);
+    m_console->CountSymbolUsage(s);
+  }
 
   if (!(s.StartsWith(wxT(":lisp ")) || s.StartsWith(wxT(":lisp\n"))))
     s.Replace(wxT("\n"), wxT(" "));
@@ -535,12 +540,16 @@ void wxMaxima::SendMaxima(wxString s, bool addToHistory)
   {
     wxString line = commands.GetNextToken();
     if (m_varRegEx.Matches(line))
+    {
       m_console->AddSymbol(m_varRegEx.GetMatch(line, 1));
+      m_console->CountSymbolUsage(m_varRegEx.GetMatch(line, 1), AC_DEFINITION_WEIGHT);
+    }
 
     if (m_funRegEx.Matches(line))
     {
       wxString funName = m_funRegEx.GetMatch(line, 1);
       m_console->AddSymbol(funName);
+      m_console->CountSymbolUsage(funName, AC_DEFINITION_WEIGHT);
 
       /// Create a template from the input
       wxString args = m_funRegEx.GetMatch(line, 2);
@@ -619,46 +628,7 @@ void wxMaxima::ClientEvent(wxSocketEvent& event)
 #else
       newChars = wxString(buffer, *wxConvCurrent);
 #endif
-      if(IsPaneDisplayed(menu_pane_xmlInspector))
-      {
-        m_xmlInspector->Add(newChars);
-      }
-
-      m_currentOutput +=newChars;
-
-      if (!m_dispReadOut &&
-	  (m_currentOutput != wxT("\n")) &&
-	  (m_currentOutput != wxT("<wxxml-symbols></wxxml-symbols>")))
-      {
-	StatusMaximaBusy(transferring);
-        m_dispReadOut = true;
-      }
-      
-      if (m_first && m_currentOutput.Find(m_firstPrompt) > -1)
-      {
-        ReadFirstPrompt(m_currentOutput);
-        if(m_batchmode)
-          m_console->AddDocumentToEvaluationQueue();
-      }
-
-
-      // The next function calls each extract and remove one type of information from
-      // the data string we got - but only do so after the piece of information it
-      // is able to detect has been transferred as a whole.
-      ReadLoadSymbols(m_currentOutput);
-
-      if(!m_first)
-        ReadMiscText(m_currentOutput);
-
-      ReadMath(m_currentOutput);
-
-      if (!m_first)
-      {
-        ReadLispError(m_currentOutput);
-        ReadMiscText(m_currentOutput);
-      }
-
-      ReadPrompt(m_currentOutput);
+      InterpretDataFromMaxima(newChars);
     }
     break;
 
@@ -698,6 +668,85 @@ void wxMaxima::ClientEvent(wxSocketEvent& event)
   }
 }
 
+void wxMaxima::InterpretDataFromMaxima(wxString newChars)
+{
+  if(IsPaneDisplayed(menu_pane_xmlInspector))
+  {
+    m_xmlInspector->Add(newChars);
+  }
+
+  m_currentOutput +=newChars;
+
+  if (!m_dispReadOut &&
+      (m_currentOutput != wxT("\n")) &&
+      (m_currentOutput != wxT("<wxxml-symbols></wxxml-symbols>")))
+  {
+    StatusMaximaBusy(transferring);
+    m_dispReadOut = true;
+  }
+  
+  if (m_first && m_currentOutput.Find(m_firstPrompt) > -1)
+  {
+    ReadFirstPrompt(m_currentOutput);
+    if(m_batchmode)
+      m_console->AddDocumentToEvaluationQueue();
+  }
+
+
+  // The next function calls each extract and remove one type of information from
+  // the data string we got - but only do so after the piece of information it
+  // is able to detect has been transferred as a whole.
+  ReadLoadSymbols(m_currentOutput);
+
+  if(!m_first)
+    ReadMiscText(m_currentOutput);
+
+  ReadMath(m_currentOutput);
+
+  if (!m_first)
+  {
+    ReadLispError(m_currentOutput);
+    ReadMiscText(m_currentOutput);
+  }
+
+  ReadPrompt(m_currentOutput);
+}
+
+void wxMaxima::StandbyEvent(wxSocketEvent& event)
+{
+  if (m_standbyClient == NULL)
+    return;
+
+  switch (event.GetSocketEvent())
+  {
+  case wxSOCKET_INPUT:
+  {
+    char buffer[SOCKET_SIZE + 1];
+    m_standbyClient->Read(buffer, SOCKET_SIZE);
+    if (!m_standbyClient->Error())
+    {
+      int read = m_standbyClient->LastCount();
+      buffer[read] = 0;
+      SanitizeSocketBuffer(buffer, read);
+#if wxUSE_UNICODE
+      m_standbyOutput += wxString(buffer, wxConvUTF8);
+#else
+      m_standbyOutput += wxString(buffer, *wxConvCurrent);
+#endif
+    }
+    break;
+  }
+
+  case wxSOCKET_LOST:
+    // The standby maxima has died before it was needed.
+    KillStandbyMaxima();
+    break;
+
+  default:
+    break;
+  }
+}
+
 /*!
  * ServerEvent is triggered when maxima connects to the socket server.
  */
@@ -709,6 +758,19 @@ void wxMaxima::ServerEvent(wxSocketEvent& event)
   case wxSOCKET_CONNECTION :
   {
     if (m_isConnected) {
+      if ((m_standbyProcess != NULL) && (m_standbyClient == NULL))
+      {
+        // This is the standby maxima. We set it up now so it is ready as soon
+        // as it is needed.
+        m_standbyClient = m_server->Accept(false);
+        if (m_standbyClient == NULL)
+          return;
+        m_standbyClient->SetEventHandler(*this, socket_standby_id);
+        m_standbyClient->SetNotify(wxSOCKET_INPUT_FLAG | wxSOCKET_LOST_FLAG);
+        m_standbyClient->Notify(true);
+        SetupVariables(m_standbyClient);
+        return;
+      }
       wxSocketBase *tmp = m_server->Accept(false);
       tmp->Close();
       return;
@@ -808,28 +870,15 @@ bool wxMaxima::StartMaxima()
   m_console->SetWorkingGroup(NULL);
 
   m_variablesOK = false;
-  wxString command = GetCommand();;
-
-  if (command.Length() > 0)
+  if (!SwitchToStandbyMaxima())
   {
+    // A standby maxima that hasn't connected to us yet might be mistaken for
+    // the maxima we start now.
+    KillStandbyMaxima();
 
-#if defined(__WXMSW__)
-    wxString clisp = command.SubString(1, command.Length() - 3);
-    clisp.Replace("\\bin\\maxima.bat", "\\clisp-*.*");
-    if (wxFindFirstFile(clisp, wxDIR).empty())
-      command.Append(wxString::Format(wxT(" -s %d "), m_port));
-    else
-      command.Append(wxString::Format(wxT(" -r \":lisp (setup-client %d)\""), m_port));
-    wxSetEnv(wxT("home"), wxGetHomeDir());
-    wxSetEnv(wxT("maxima_signals_thread"), wxT("1"));
-#else
-    command.Append(wxString::Format(wxT(" -r \":lisp (setup-client %d)\""),
-                                    m_port));
-#endif
-
-#if defined __WXMAC__
-    wxSetEnv(wxT("DISPLAY"), wxT(":0.0"));
-#endif
+    wxString command = MaximaCommandLine();
+    if (command.Length() == 0)
+      return false;
 
     m_process = new wxProcess(this, maxima_process_id);
     m_process->Redirect();
@@ -842,8 +891,6 @@ bool wxMaxima::StartMaxima()
 
     SetStatusText(_("Maxima started. Waiting for connection..."), 1);
   }
-  else
-    return false;
 
   if (m_openFile.Length())
   {
@@ -854,6 +901,126 @@ bool wxMaxima::StartMaxima()
 }
 
 
+wxString wxMaxima::MaximaCommandLine()
+{
+  wxString command = GetCommand();
+  if (command.Length() == 0)
+    return command;
+
+#if defined(__WXMSW__)
+  wxString clisp = command.SubString(1, command.Length() - 3);
+  clisp.Replace("\\bin\\maxima.bat", "\\clisp-*.*");
+  if (wxFindFirstFile(clisp, wxDIR).empty())
+    command.Append(wxString::Format(wxT(" -s %d "), m_port));
+  else
+    command.Append(wxString::Format(wxT(" -r \":lisp (setup-client %d)\""), m_port));
+  wxSetEnv(wxT("home"), wxGetHomeDir());
+  wxSetEnv(wxT("maxima_signals_thread"), wxT("1"));
+#else
+  command.Append(wxString::Format(wxT(" -r \":lisp (setup-client %d)\""),
+                                  m_port));
+#endif
+
+#if defined __WXMAC__
+  wxSetEnv(wxT("DISPLAY"), wxT(":0.0"));
+#endif
+  return command;
+}
+
+void wxMaxima::StartStandbyMaxima()
+{
+  bool standbyMaxima = false;
+  wxConfig::Get()->Read(wxT("standbyMaxima"), &standbyMaxima);
+  if (!standbyMaxima || !m_isConnected || m_first || (m_standbyProcess != NULL))
+    return;
+
+  wxString command = MaximaCommandLine();
+  if (command.Length() == 0)
+    return;
+
+  m_standbyProcess = new wxProcess(this, maxima_process_id);
+  m_standbyProcess->Redirect();
+  m_standbyOutput = wxEmptyString;
+  m_standbyPid = wxExecute(command, wxEXEC_ASYNC, m_standbyProcess);
+  if (m_standbyPid <= 0)
+  {
+    delete m_standbyProcess;
+    m_standbyProcess = NULL;
+    m_standbyPid = -1;
+  }
+}
+
+bool wxMaxima::SwitchToStandbyMaxima()
+{
+  if (m_standbyClient == NULL)
+    return false;
+
+  if (m_client != NULL)
+  {
+    // The old maxima has been killed on purpose => we don't want to be told
+    // that the connection to it has been lost.
+    m_client->Notify(false);
+    m_client->Destroy();
+  }
+
+  m_client = m_standbyClient;
+  m_client->SetEventHandler(*this, socket_client_id);
+  m_process = m_standbyProcess;
+  m_input = m_process->GetInputStream();
+  m_error = m_process->GetErrorStream();
+  m_standbyClient = NULL;
+  m_standbyProcess = NULL;
+  m_standbyPid = -1;
+
+  m_isConnected = true;
+  m_first = true;
+  m_pid = -1;
+  // The standby maxima has already been set up.
+  m_variablesOK = true;
+  m_currentOutput = wxEmptyString;
+  SetStatusText(_("Switched to the standby maxima."), 1);
+#ifndef __WXMSW__
+  ReadProcessOutput();
+#endif
+  if (m_currentFile != wxEmptyString)
+    SetCWD(m_currentFile);
+
+  // Everything the standby maxima has sent us so far, including its first prompt
+  wxString output = m_standbyOutput;
+  m_standbyOutput = wxEmptyString;
+  if (!output.IsEmpty())
+    InterpretDataFromMaxima(output);
+  return true;
+}
+
+void wxMaxima::KillStandbyMaxima()
+{
+  if (m_standbyClient != NULL)
+  {
+    // Maxima will quit as soon as it has read everything we sent before.
+    wxString quit = wxT("quit();\n");
+#if wxUSE_UNICODE
+    m_standbyClient->Write(quit.utf8_str(), strlen(quit.utf8_str()));
+#else
+    m_standbyClient->Write(quit.c_str(), quit.Length());
+#endif
+    m_standbyClient->Notify(false);
+    m_standbyClient->Destroy();
+    m_standbyClient = NULL;
+  }
+
+  if (m_standbyProcess != NULL)
+  {
+    // A detached process deletes itself as soon as it terminates.
+    m_standbyProcess->Detach();
+    if (m_standbyPid > 0)
+      wxProcess::Kill(m_standbyPid, wxSIGKILL);
+  }
+  m_standbyProcess = NULL;
+  m_standbyPid = -1;
+  m_standbyOutput = wxEmptyString;
+}
+
 void wxMaxima::Interrupt(wxCommandEvent& event)
 {
   if (m_pid < 0)
@@ -890,6 +1057,15 @@ void wxMaxima::KillMaxima()
 
 void wxMaxima::OnProcessEvent(wxProcessEvent& event)
 {
+  if ((m_standbyPid > 0) && (event.GetPid() == m_standbyPid))
+  {
+    // The standby maxima has terminated before it was needed. A process that
+    // isn't detached has to be deleted by whoever handles its termination.
+    wxDELETE(m_standbyProcess);
+    KillStandbyMaxima();
+    return;
+  }
+
   if (!m_closing)
     SetStatusText(_("Maxima process terminated."), 1);
 
@@ -906,6 +1082,7 @@ void wxMaxima::CleanUp()
     m_client->Notify(false);
   if (m_isConnected)
     KillMaxima();
+  KillStandbyMaxima();
   if (m_isRunning)
     m_server->Destroy();
 }
@@ -938,6 +1115,7 @@ void wxMaxima::ReadFirstPrompt(wxString &data)
     GetMenuBar()->Enable(menu_interrupt_id, true);
 
   m_first = false;
+  MyApp::StartupFinished();
   m_inLispMode = false;
   StatusMaximaBusy(waiting);
   m_closing = false; // when restarting maxima this is temporarily true
@@ -957,6 +1135,9 @@ void wxMaxima::ReadFirstPrompt(wxString &data)
   {
     TryEvaluateNextInQueue();
   }
+
+  // Now that this maxima is up and running we can prepare the next one.
+  StartStandbyMaxima();
 }
 
 void wxMaxima::ReadMiscText(wxString &data)
@@ -1582,16 +1763,32 @@ void wxMaxima::ReadProcessOutput()
 }
 #endif
 
-void wxMaxima::SetupVariables()
+void wxMaxima::SendSetupCommand(wxString command, wxSocketBase *standby)
 {
-  SendMaxima(wxT(":lisp-quiet (setf *prompt-suffix* \"") +
-             m_promptSuffix +
-             wxT("\")"));
-  SendMaxima(wxT(":lisp-quiet (setf *prompt-prefix* \"") +
-             m_promptPrefix +
-             wxT("\")"));
-  SendMaxima(wxT(":lisp-quiet (setf $in_netmath nil)"));
-  SendMaxima(wxT(":lisp-quiet (setf $show_openplot t)"));
+  if (standby == NULL)
+  {
+    SendMaxima(command);
+    return;
+  }
+
+  command.Append(wxT("\n"));
+#if wxUSE_UNICODE
+  standby->Write(command.utf8_str(), strlen(command.utf8_str()));
+#else
+  standby->Write(command.c_str(), command.Length());
+#endif
+}
+
+void wxMaxima::SetupVariables(wxSocketBase *standby)
+{
+  SendSetupCommand(wxT(":lisp-quiet (setf *prompt-suffix* \"") +
+                   m_promptSuffix +
+                   wxT("\")"), standby);
+  SendSetupCommand(wxT(":lisp-quiet (setf *prompt-prefix* \"") +
+                   m_promptPrefix +
+                   wxT("\")"), standby);
+  SendSetupCommand(wxT(":lisp-quiet (setf $in_netmath nil)"), standby);
+  SendSetupCommand(wxT(":lisp-quiet (setf $show_openplot t)"), standby);
   
   wxConfigBase *config = wxConfig::Get();
   
@@ -1602,10 +1799,10 @@ void wxMaxima::SetupVariables()
   #endif
   
   if(wxcd) {
-    SendMaxima(wxT(":lisp-quiet (defparameter $wxchangedir t)"));
+    SendSetupCommand(wxT(":lisp-quiet (defparameter $wxchangedir t)"), standby);
   }
   else {
-    SendMaxima(wxT(":lisp-quiet (defparameter $wxchangedir nil)"));
+    SendSetupCommand(wxT(":lisp-quiet (defparameter $wxchangedir nil)"), standby);
   }
 
 #if defined (__WXMAC__)
@@ -1615,9 +1812,9 @@ void wxMaxima::SetupVariables()
 #endif
   config->Read(wxT("usepngCairo"),&usepngCairo);
   if(usepngCairo)
-    SendMaxima(wxT(":lisp-quiet (defparameter $wxplot_pngcairo t)"));
+    SendSetupCommand(wxT(":lisp-quiet (defparameter $wxplot_pngcairo t)"), standby);
   else
-    SendMaxima(wxT(":lisp-quiet (defparameter $wxplot_pngcairo nil)"));
+    SendSetupCommand(wxT(":lisp-quiet (defparameter $wxplot_pngcairo nil)"), standby);
 
   int autosubscript = 1;
   config->Read(wxT("autosubscript"), &autosubscript);
@@ -1634,33 +1831,34 @@ void wxMaxima::SetupVariables()
     subscriptval="'all";
     break;
   }
-  SendMaxima(wxT(":lisp-quiet (defparameter $wxsubscripts ") + subscriptval + wxT(")"));
+  SendSetupCommand(wxT(":lisp-quiet (defparameter $wxsubscripts ") + subscriptval + wxT(")"), standby);
 
   int defaultPlotWidth = 600;
   config->Read(wxT("defaultPlotWidth"), &defaultPlotWidth);
   int defaultPlotHeight = 400;
   config->Read(wxT("defaultPlotHeight"), &defaultPlotHeight);
-  SendMaxima(wxString::Format(wxT(":lisp-quiet (defparameter $wxplot_size '((mlist simp) %i %i))"),defaultPlotWidth,defaultPlotHeight));
+  SendSetupCommand(wxString::Format(wxT(":lisp-quiet (defparameter $wxplot_size '((mlist simp) %i %i))"),defaultPlotWidth,defaultPlotHeight), standby);
   
 #if defined (__WXMSW__)
   wxString cwd = wxGetCwd();
   cwd.Replace(wxT("\\"), wxT("/"));
-  SendMaxima(wxT(":lisp-quiet ($load \"") + cwd + wxT("/data/wxmathml\")"));
+  SendSetupCommand(wxT(":lisp-quiet ($load \"") + cwd + wxT("/data/wxmathml\")"), standby);
 #elif defined (__WXMAC__)
   wxString cwd = wxGetCwd();
   cwd = cwd + wxT("/") + wxT(MACPREFIX);
-  SendMaxima(wxT(":lisp-quiet ($load \"") + cwd + wxT("wxmathml\")"));
+  SendSetupCommand(wxT(":lisp-quiet ($load \"") + cwd + wxT("wxmathml\")"), standby);
   // check for Gnuplot.app - use it if it exists
   wxString gnuplotbin(wxT("/Applications/Gnuplot.app/Contents/Resources/bin/gnuplot"));
   if (wxFileExists(gnuplotbin))
-    SendMaxima(wxT(":lisp-quiet (setf $gnuplot_command \"") + gnuplotbin + wxT("\")"));
+    SendSetupCommand(wxT(":lisp-quiet (setf $gnuplot_command \"") + gnuplotbin + wxT("\")"), standby);
 #else
   wxString prefix = wxT(PREFIX);
-  SendMaxima(wxT(":lisp-quiet ($load \"") + prefix +
-             wxT("/share/wxMaxima/wxmathml\")"));
+  SendSetupCommand(wxT(":lisp-quiet ($load \"") + prefix +
+                   wxT("/share/wxMaxima/wxmathml\")"), standby);
 #endif
 
-  if (m_currentFile != wxEmptyString)
+  // The working directory of a standby maxima is set when it takes over.
+  if ((standby == NULL) && (m_currentFile != wxEmptyString))
   {
     wxString filename(m_currentFile);
     
@@ -2004,6 +2202,14 @@ void wxMaxima::OnIdle(wxIdleEvent& event)
       m_console->m_structure->Update(m_console->GetTree(),m_console->GetHCaret());
     }
   }
+
+  // Lay out the cells a forced recalculation has left for later, one batch
+  // at a time so wxMaxima stays responsive.
+  if(m_console->RecalculatePending())
+    event.RequestMore();
+  // Index the text that has changed so the next search is fast.
+  else if(SearchIndex::Update(SEARCHINDEX_BATCH_TIMEOUT))
+    event.RequestMore();
      
   // Tell wxWidgets it can process its own idle commands, as well.
   event.Skip();
@@ -2674,10 +2880,19 @@ void wxMaxima::EditMenu(wxCommandEvent& event)
       configW->WriteSettings();
       // Write the changes in the configuration to the disk.
       config->Flush();
+      // The fonts might have changed => forget all glyph metrics and text sizes.
+      GlyphMetrics::ClearCache();
+      TextCell::ClearSizeCache();
+      // ...and re-read the text styles and the fonts that are available.
+      ParserStyle::ClearCache();
+      EditorCell::ClearUndoMemoryLimitCache();
       // Refresh the display as the settings that affect it might have changed.
       m_console->RecalculateForce();
       m_console->Refresh();
       ConfigChanged();
+      // The standby maxima has been set up using the old configuration.
+      KillStandbyMaxima();
+      StartStandbyMaxima();
     }
 
     configW->Destroy();
@@ -2869,6 +3084,7 @@ void wxMaxima::EditMenu(wxCommandEvent& event)
 #endif
     if ( m_console->m_findDialog != NULL )
     {
+      m_console->HighlightMatches(wxEmptyString, false);
       m_console->m_findDialog->Destroy();
       m_console->m_findDialog = NULL;
     }
@@ -2908,14 +3124,25 @@ void wxMaxima::EditMenu(wxCommandEvent& event)
 
 void wxMaxima::OnFind(wxFindDialogEvent& event)
 {
+  bool ignoreCase = !(event.GetFlags() & wxFR_MATCHCASE);
   if (!m_console->FindNext(event.GetFindString(),
                            event.GetFlags() & wxFR_DOWN,
-                           !(event.GetFlags() & wxFR_MATCHCASE)))
+                           ignoreCase))
+  {
+    m_console->HighlightMatches(wxEmptyString, ignoreCase);
     wxMessageBox(_("No matches found!"));
+  }
+  else
+  {
+    m_console->HighlightMatches(event.GetFindString(), ignoreCase);
+    SetStatusText(wxString::Format(_("%d matches found."),
+                                   m_console->CountMatches(event.GetFindString(), ignoreCase)));
+  }
 }
 
 void wxMaxima::OnFindClose(wxFindDialogEvent& event)
 {
+  m_console->HighlightMatches(wxEmptyString, false);
   m_console->m_findDialog->Destroy();
   m_console->m_findDialog = NULL;
 }
@@ -4950,7 +5177,7 @@ wxString wxMaxima::GetUnmatchedParenthesisState(wxString text)
     case wxT(')'):
     case wxT(']'):
     case wxT('}'):
-      if(c!=delimiters.back()) return(_("Mismatched parenthesis"));
+      if((delimiters.empty()) || (c!=delimiters.back())) return(_("Mismatched parenthesis"));
       delimiters.pop_back();
       lastC=c;
       break;
@@ -5709,6 +5936,7 @@ EVT_TOOL(ToolBar::tb_find, wxMaxima::EditMenu)
 EVT_TOOL(ToolBar::tb_follow,wxMaxima::OnFollow)
 EVT_SOCKET(socket_server_id, wxMaxima::ServerEvent)
 EVT_SOCKET(socket_client_id, wxMaxima::ClientEvent)
+EVT_SOCKET(socket_standby_id, wxMaxima::StandbyEvent)
 /* These commands somehow caused the menu to be updated six times on every
    keypress and the tool bar to be updated six times on every menu update
 
@@ -29,6 +29,7 @@
 #include <wx/config.h>
 #include <wx/process.h>
 #include <wx/regex.h>
+#include <wx/stopwatch.h>
 #include <wx/html/htmlwin.h>
 #include <wx/dnd.h>
 
@@ -213,6 +214,17 @@ protected:
     until we got a full line we can display.
    */
   void ClientEvent(wxSocketEvent& event);
+  /*! Is triggered on input from or disconnect of the standby maxima
+
+    Everything the standby maxima sends before it takes over is collected in
+    m_standbyOutput and interpreted only after it has taken over.
+   */
+  void StandbyEvent(wxSocketEvent& event);
+  /*! Interpret data maxima has sent us
+
+    \param newChars The data that has arrived since the last call of this function
+   */
+  void InterpretDataFromMaxima(wxString newChars);
 
   void ConsoleAppend(wxString s, int type);        //!< append maxima output to console
   void DoConsoleAppend(wxString s, int type,       //
@@ -245,6 +257,27 @@ protected:
   wxString GetDefaultEntry();
   bool StartServer();                              //!< starts the server
   bool StartMaxima();                              //!< starts maxima (uses getCommand)
+  /*! The command line that starts a maxima that connects to our server
+
+    Sets the environment variables maxima needs, as well.
+    \return wxEmptyString, if no maxima could be found.
+   */
+  wxString MaximaCommandLine();
+  /*! Start a maxima in the background that is ready to replace the current one
+
+    Does nothing if the user hasn't enabled this in the configuration, if
+    there already is a standby maxima or if the current maxima hasn't finished
+    starting up yet: We can only tell which connection to our server belongs to
+    which maxima process if they don't start at the same time.
+   */
+  void StartStandbyMaxima();
+  /*! Make the standby maxima the current one
+
+    \return false, if there is no standby maxima that has connected to us yet.
+   */
+  bool SwitchToStandbyMaxima();
+  //! Kill the standby maxima, for example because the configuration has changed
+  void KillStandbyMaxima();
   void OnClose(wxCloseEvent& event);               //!< close wxMaxima window
   wxString GetCommand(bool params = true);         //!< returns the command to start maxima
                                                    //    (uses guessConfiguration)
@@ -307,10 +340,19 @@ protected:
     This method is called once when maxima starts. It loads wxmathml.lisp
     and sets some option variables.
 
+    \param standby The socket of a standby maxima that is to be set up instead
+    of the current maxima.
+
     \todo Set pngcairo to be the default terminal as soon as the mac platform 
     supports it.
  */
-  void SetupVariables();
+  void SetupVariables(wxSocketBase *standby = NULL);
+  /*! Send one of the commands that set up a new maxima
+
+    \param command The command
+    \param standby The socket of the standby maxima or NULL for the current maxima
+   */
+  void SendSetupCommand(wxString command, wxSocketBase *standby);
   void KillMaxima();                 //!< kills the maxima process
   /*! Update the title
 
@@ -349,6 +391,14 @@ protected:
   //! The process id of maxima. Is determined by ReadFirstPrompt.
   long m_pid;
   wxProcess *m_process;
+  //! The maxima that waits for taking over or NULL
+  wxProcess *m_standbyProcess;
+  //! The process id wxExecute has returned for the standby maxima
+  long m_standbyPid;
+  //! The connection to the standby maxima or NULL, if it hasn't connected yet
+  wxSocketBase *m_standbyClient;
+  //! Everything the standby maxima has sent us so far
+  wxString m_standbyOutput;
   // The stdout of the maxima process
   wxInputStream *m_input;
   // The stderr of the maxima process
@@ -410,6 +460,8 @@ class MyApp : public wxApp
 {
 public:
   virtual bool OnInit();
+  //! Frees the caches that live as long as the program does
+  virtual int OnExit();
   wxLocale m_locale;
   /*! Create a new window
 
@@ -421,6 +473,23 @@ public:
   static void Cleanup_Static();
   //! A pointer to the currently running wxMaxima instance
   static wxMaxima *m_frame;
+  /*! Report the time a startup phase has taken
+
+    Does nothing unless wxMaxima has been started with --startup-profile.
+    Otherwise prints the time since the last phase has ended and the time
+    since the program was started.
+   */
+  static void StartupPhase(wxString phase);
+  //! Report the end of the startup: The first prompt has arrived
+  static void StartupFinished();
+private:
+  //! Has wxMaxima been started with --startup-profile?
+  static bool m_startupProfile;
+  //! Measures the time since the program has been started
+  static wxStopWatch m_startupTime;
+  //! The time the last startup phase has ended at
+  static long m_lastStartupPhase;
+public:
 #if defined (__WXMAC__)
   wxWindowList topLevelWindows;
   void OnFileMenu(wxCommandEvent &ev);
@@ -28,6 +28,7 @@
 #include <wx/config.h>
 #include <wx/image.h>
 #include <wx/filename.h>
+#include <wx/tokenzr.h>
 
 wxMaximaFrame::wxMaximaFrame(wxWindow* parent, int id, const wxString& title,
                              const wxPoint& pos, const wxSize& size,
@@ -227,6 +228,11 @@ void wxMaximaFrame::StatusExportFailed()
 wxMaximaFrame::~wxMaximaFrame()
 {
   wxString perspective = m_manager.SavePerspective();
+  // Keep the layout of the panes that haven't been created in this session
+  for (std::map<wxString, wxString>::iterator it = m_deferredPanes.begin();
+       it != m_deferredPanes.end(); ++it)
+    if (!it->second.IsEmpty())
+      perspective += it->second + wxT("|");
 
   wxConfig::Get()->Write(wxT("AUI/perspective"), perspective);
 #if defined __WXMAC__ || defined __WXMSW__
@@ -297,69 +303,61 @@ void wxMaximaFrame::do_layout()
                     PaneBorder(true).
                     Right());
 
-  m_manager.AddPane(CreateStatPane(),
-                    wxAuiPaneInfo().Name(wxT("stats")).
-                    Caption(_("Statistics")).
-                    Show(false).
-                    TopDockable(true).
-                    BottomDockable(true).
-                    PaneBorder(true).
-                    Fixed().
-                    Left());
-
-#ifdef wxUSE_UNICODE
-  m_manager.AddPane(CreateGreekPane(),
-                    wxAuiPaneInfo().Name(wxT("greek")).
-                    Caption(_("Greek letters")).
-                    Show(false).
-                    TopDockable(true).
-                    BottomDockable(true).
-                    PaneBorder(true).
-                    Fixed().
-                    Left());
-  m_manager.AddPane(CreateSymbolsPane(),
-                    wxAuiPaneInfo().Name(wxT("symbols")).
-                    Caption(_("Mathematical Symbols")).
-                    Show(false).
-                    TopDockable(true).
-                    BottomDockable(true).
-                    PaneBorder(true).
-                    Fixed().
-                    Left());
-#endif
-  
-  m_manager.AddPane(CreateMathPane(),
-                    wxAuiPaneInfo().Name(wxT("math")).
-                    Caption(_("General Math")).
-                    Show(false).
-                    TopDockable(true).
-                    BottomDockable(true).
-                    PaneBorder(true).
-                    Fixed().
-                    Left());
-
-  m_manager.AddPane(CreateFormatPane(),
-                    wxAuiPaneInfo().Name(wxT("format")).
-                    Caption(_("Insert")).
-                    Show(false).
-                    TopDockable(true).
-                    BottomDockable(true).
-                    PaneBorder(true).
-                    Fixed().
-                    Left());
-
   wxConfigBase *config = wxConfig::Get();
   bool loadPanes = true;
   config->Read(wxT("AUI/savePanes"), &loadPanes);
 
-  if (loadPanes) {
-    wxString perspective;
-    bool toolbar = true;
-    if (config->Read(wxT("AUI/perspective"), &perspective))
+  wxString perspective;
+  if (loadPanes)
+    config->Read(wxT("AUI/perspective"), &perspective);
+
+  // Find out which of the button panes are visible according to the saved
+  // perspective. Only these are created now, the others on demand.
+  std::map<wxString, wxString> paneParts;
+  {
+    wxString input = perspective;
+    input.Replace(wxT("\\|"), wxT("\a"));
+    wxStringTokenizer parts(input, wxT("|"));
+    while (parts.HasMoreTokens())
     {
-      if(!perspective.IsEmpty())
-        m_manager.LoadPerspective(perspective);
+      wxString part = parts.GetNextToken();
+      part.Replace(wxT("\a"), wxT("\\|"));
+      wxString name = part.AfterFirst(wxT('=')).BeforeFirst(wxT(';'));
+      if (part.StartsWith(wxT("name=")))
+        paneParts[name] = part;
     }
+  }
+
+  const wxChar *buttonPanes[] = {
+    wxT("stats"),
+#ifdef wxUSE_UNICODE
+    wxT("greek"),
+    wxT("symbols"),
+#endif
+    wxT("math"),
+    wxT("format")
+  };
+  for (size_t i = 0; i < sizeof(buttonPanes) / sizeof(buttonPanes[0]); i++)
+  {
+    wxString name = buttonPanes[i];
+    wxString part;
+    if (paneParts.find(name) != paneParts.end())
+      part = paneParts[name];
+
+    // All button panes are hidden by default.
+    wxAuiPaneInfo info;
+    if (!part.IsEmpty())
+      m_manager.LoadPaneInfo(part, info);
+    if (!part.IsEmpty() && info.IsShown())
+      AddButtonPane(name);
+    else
+      m_deferredPanes[name] = part;
+  }
+
+  if (loadPanes) {
+    bool toolbar = true;
+    if(!perspective.IsEmpty())
+      m_manager.LoadPerspective(perspective);
     config->Read(wxT("AUI/toolbar"), &toolbar);
     ShowToolBar(toolbar);
   }
@@ -367,6 +365,66 @@ void wxMaximaFrame::do_layout()
     m_manager.Update();
 }
 
+void wxMaximaFrame::AddButtonPane(wxString name, wxString perspective)
+{
+  wxPanel *panel = NULL;
+  wxString caption;
+  if (name == wxT("stats"))
+  {
+    panel = CreateStatPane();
+    caption = _("Statistics");
+  }
+#ifdef wxUSE_UNICODE
+  else if (name == wxT("greek"))
+  {
+    panel = CreateGreekPane();
+    caption = _("Greek letters");
+  }
+  else if (name == wxT("symbols"))
+  {
+    panel = CreateSymbolsPane();
+    caption = _("Mathematical Symbols");
+  }
+#endif
+  else if (name == wxT("math"))
+  {
+    panel = CreateMathPane();
+    caption = _("General Math");
+  }
+  else if (name == wxT("format"))
+  {
+    panel = CreateFormatPane();
+    caption = _("Insert");
+  }
+
+  wxASSERT(panel != NULL);
+  if (panel == NULL)
+    return;
+
+  wxAuiPaneInfo info = wxAuiPaneInfo().Name(name).
+    Caption(caption).
+    Show(false).
+    TopDockable(true).
+    BottomDockable(true).
+    PaneBorder(true).
+    Fixed().
+    Left();
+  if (!perspective.IsEmpty())
+    m_manager.LoadPaneInfo(perspective, info);
+  m_manager.AddPane(panel, info);
+}
+
+void wxMaximaFrame::CreateDeferredPane(wxString name)
+{
+  std::map<wxString, wxString>::iterator it = m_deferredPanes.find(name);
+  if (it == m_deferredPanes.end())
+    return;
+
+  wxString perspective = it->second;
+  m_deferredPanes.erase(it);
+  AddButtonPane(name, perspective);
+}
+
 void wxMaximaFrame::SetupMenu()
 {
   m_MenuBar = new wxMenuBar();
@@ -1002,36 +1060,56 @@ void wxMaximaFrame::RemoveRecentDocument(wxString file)
   UpdateRecentDocuments();
 }
 
+bool wxMaximaFrame::IsPaneShown(wxString name)
+{
+  // A pane that hasn't been created yet isn't shown. GetPane() would return
+  // the pane info all unknown names share, instead.
+  if (m_deferredPanes.find(name) != m_deferredPanes.end())
+    return false;
+  return m_manager.GetPane(name).IsShown();
+}
+
+void wxMaximaFrame::SetPaneShown(wxString name, bool show)
+{
+  if (show)
+    CreateDeferredPane(name);
+  // Hiding a pane that hasn't been created yet would change the pane info
+  // all unknown names share.
+  else if (m_deferredPanes.find(name) != m_deferredPanes.end())
+    return;
+  m_manager.GetPane(name).Show(show);
+}
+
 bool wxMaximaFrame::IsPaneDisplayed(Event id)
 {
   bool displayed = false;
 
   switch (id) {
   case menu_pane_math:
-    displayed = m_manager.GetPane(wxT("math")).IsShown();
+    displayed = IsPaneShown(wxT("math"));
     break;
   case menu_pane_history:
-    displayed = m_manager.GetPane(wxT("history")).IsShown();
+    displayed = IsPaneShown(wxT("history"));
     break;
   case menu_pane_structure:
-    displayed = m_manager.GetPane(wxT("structure")).IsShown();
+    displayed = IsPaneShown(wxT("structure"));
     break;
   case menu_pane_xmlInspector:
-    displayed = m_manager.GetPane(wxT("XmlInspector")).IsShown();
+    displayed = IsPaneShown(wxT("XmlInspector"));
     break;
   case menu_pane_stats:
-    displayed = m_manager.GetPane(wxT("stats")).IsShown();
+    displayed = IsPaneShown(wxT("stats"));
     break;
 #ifdef wxUSE_UNICODE
   case menu_pane_greek:
-    displayed = m_manager.GetPane(wxT("greek")).IsShown();
+    displayed = IsPaneShown(wxT("greek"));
     break;
   case menu_pane_symbols:
-    displayed = m_manager.GetPane(wxT("symbols")).IsShown();
+    displayed = IsPaneShown(wxT("symbols"));
     break;
 #endif
   case menu_pane_format:
-    displayed = m_manager.GetPane(wxT("format")).IsShown();
+    displayed = IsPaneShown(wxT("format"));
     break;
   default:
     wxASSERT(false);
@@ -1045,47 +1123,47 @@ void wxMaximaFrame::ShowPane(Event id, bool show)
 {
   switch (id) {
   case menu_pane_math:
-    m_manager.GetPane(wxT("math")).Show(show);
+    SetPaneShown(wxT("math"), show);
     break;
   case menu_pane_history:
-    m_manager.GetPane(wxT("history")).Show(show);
+    SetPaneShown(wxT("history"), show);
     break;
   case menu_pane_structure:
   {
-    m_manager.GetPane(wxT("structure")).Show(show);
+    SetPaneShown(wxT("structure"), show);
     m_console->m_structure->Update(m_console->GetTree(),m_console->GetHCaret());
     break;
   }
   case menu_pane_xmlInspector:
   {
-    m_manager.GetPane(wxT("XmlInspector")).Show(show);
+    SetPaneShown(wxT("XmlInspector"), show);
     break;
   }
   case menu_pane_stats:
-    m_manager.GetPane(wxT("stats")).Show(show);
+    SetPaneShown(wxT("stats"), show);
     break;
 #ifdef wxUSE_UNICODE
   case menu_pane_greek:
-    m_manager.GetPane(wxT("greek")).Show(show);
+    SetPaneShown(wxT("greek"), show);
     break;
   case menu_pane_symbols:
-    m_manager.GetPane(wxT("symbols")).Show(show);
+    SetPaneShown(wxT("symbols"), show);
     break;
 #endif
   case menu_pane_format:
-    m_manager.GetPane(wxT("format")).Show(show);
+    SetPaneShown(wxT("format"), show);
     break;
   case menu_pane_hideall:
-    m_manager.GetPane(wxT("math")).Show(false);
-    m_manager.GetPane(wxT("history")).Show(false);
-    m_manager.GetPane(wxT("structure")).Show(false);
-    m_manager.GetPane(wxT("XmlInspector")).Show(false);
-    m_manager.GetPane(wxT("stats")).Show(false);
+    SetPaneShown(wxT("math"), false);
+    SetPaneShown(wxT("history"), false);
+    SetPaneShown(wxT("structure"), false);
+    SetPaneShown(wxT("XmlInspector"), false);
+    SetPaneShown(wxT("stats"), false);
 #ifdef wxUSE_UNICODE
-    m_manager.GetPane(wxT("greek")).Show(false);
-    m_manager.GetPane(wxT("symbols")).Show(false);
+    SetPaneShown(wxT("greek"), false);
+    SetPaneShown(wxT("symbols"), false);
 #endif
-    m_manager.GetPane(wxT("format")).Show(false);
+    SetPaneShown(wxT("format"), false);
     break;
   default:
     wxASSERT(false);
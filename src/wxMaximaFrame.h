@@ -31,6 +31,7 @@
 #include <wx/bmpbuttn.h>
 #include <wx/arrstr.h>
 #include <wx/aui/aui.h>
+#include <map>
 
 #include "MathCtrl.h"
 #include "Setup.h"
@@ -93,6 +94,7 @@ public:
 
     socket_client_id,
     socket_server_id,
+    socket_standby_id,
     input_line_id,
     refresh_id,
     menu_new_id,
@@ -445,6 +447,31 @@ private:
   wxPanel *CreateGreekPane();
   wxPanel *CreateSymbolsPane();
 #endif
+  /*! Create one of the button panes and add it to the wxAuiManager
+
+    \param name The name of the pane ("stats", "greek", "symbols", "math" or "format")
+    \param perspective The part of a saved perspective that describes this pane
+                       or wxEmptyString if the pane's default layout is to be used
+   */
+  void AddButtonPane(wxString name, wxString perspective = wxEmptyString);
+  /*! Create a button pane that hasn't been created on startup
+
+    Creating the button panes means creating hundreds of buttons and bitmaps.
+    Since most of them are hidden most of the time we only create the panes
+    that are visible on startup and create the others when they are shown
+    for the first time.
+   */
+  void CreateDeferredPane(wxString name);
+  //! Is the pane with this name shown? Panes that haven't been created aren't.
+  bool IsPaneShown(wxString name);
+  //! Show or hide a pane, creating it first if it is shown for the first time
+  void SetPaneShown(wxString name, bool show);
+  /*! The button panes that haven't been created yet
+
+    Maps the name of the pane to the part of the saved perspective that
+    describes it so its layout survives even if it isn't created in this session.
+   */
+  std::map<wxString, wxString> m_deferredPanes;
 protected:
   void CharacterButtonPressed(wxMouseEvent &event);
   void LoadRecentDocuments();